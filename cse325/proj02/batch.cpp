@@ -0,0 +1,276 @@
+#include "batch.h"
+
+#include <iostream>
+#include <fstream>			// for reading the manifest
+#include <sstream>			// for splitting manifest lines
+#include <algorithm>		// for std::stable_sort, std::min
+#include <cerrno>			// for EEXIST
+#include <pthread.h>		// for the worker pool
+#include <dirent.h>			// for opendir(), readdir()
+#include <sys/stat.h>		// for stat(), lstat(), mkdir()
+
+
+bool loadManifest(const std::string &path, const CopyJob &defaults, std::vector<CopyJob> &jobs,
+				  unsigned &invalid)
+{
+	std::ifstream manifest(path);
+	if (!manifest)
+	{
+		std::cerr << "Error opening manifest '" << path << "'." << std::endl;
+		return false;
+	}
+
+	std::string line;
+	unsigned lineNumber = 0;
+	while (std::getline(manifest, line))
+	{
+		lineNumber++;
+
+		// Whitespace separated, the same words the command line would take
+		std::istringstream words(line);
+		std::vector<std::string> args;
+		std::string word;
+		while (words >> word)
+		{
+			args.push_back(word);
+		}
+		if (args.empty() || args[0][0] == '#')
+		{
+			continue;
+		}
+
+		CopyJob job = defaults;
+		if (parseArguments(args, job) != 0 || job.fileIn.empty() || job.fileOut.empty())
+		{
+			std::cerr << "Error: Manifest line " << lineNumber << " skipped." << std::endl;
+			invalid++;
+			continue;
+		}
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+
+/// @brief Walk one directory level of the tree, recursing into subdirectories
+static bool scanDirectory(const CopyJob &defaults, const std::string &source,
+						  const std::string &destination, std::vector<CopyJob> &jobs)
+{
+	// The destination directory gets the source's permissions, but always
+	// stays writable for us so the copies below it can be created
+	struct stat dirStat;
+	if (stat(source.c_str(), &dirStat) == -1 || !S_ISDIR(dirStat.st_mode))
+	{
+		std::cerr << "Error: '" << source << "' is not a directory." << std::endl;
+		return false;
+	}
+	if (mkdir(destination.c_str(), (dirStat.st_mode & 07777) | S_IRWXU) == -1 && errno != EEXIST)
+	{
+		std::cerr << "Error creating directory '" << destination << "'." << std::endl;
+		return false;
+	}
+
+	DIR *dir = opendir(source.c_str());
+	if (!dir)
+	{
+		std::cerr << "Error opening directory '" << source << "'." << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+		{
+			continue;
+		}
+		std::string sourcePath = source + "/" + name;
+		std::string destinationPath = destination + "/" + name;
+
+		// lstat() so symlinks are seen as links and never followed out of the tree
+		struct stat entryStat;
+		if (lstat(sourcePath.c_str(), &entryStat) == -1)
+		{
+			std::cerr << "Error reading '" << sourcePath << "'." << std::endl;
+			ok = false;
+		}
+		else if (S_ISDIR(entryStat.st_mode))
+		{
+			ok = scanDirectory(defaults, sourcePath, destinationPath, jobs) && ok;
+		}
+		else if (S_ISREG(entryStat.st_mode))
+		{
+			CopyJob job = defaults;
+			job.fileIn = sourcePath;
+			job.fileOut = destinationPath;
+			jobs.push_back(job);
+		}
+		else
+		{
+			std::cerr << "Skipping '" << sourcePath << "': not a regular file." << std::endl;
+		}
+	}
+	closedir(dir);
+	return ok;
+}
+
+
+/// @brief True if path is the directory dir or lies somewhere below it. A path
+/// that does not exist yet is judged by its deepest part that does. Compares
+/// device and inode numbers, so symlinks and "." or ".." in either path
+/// cannot hide that they are the same directory.
+static bool insideDirectory(const std::string &path, const struct stat &dir)
+{
+	std::string current = path;
+	struct stat currentStat;
+	while (stat(current.c_str(), &currentStat) == -1)
+	{
+		if (current == "." || current == "/")
+		{
+			return false;
+		}
+		size_t slash = current.find_last_of('/');
+		current = slash == std::string::npos ? "." : slash == 0 ? "/" : current.substr(0, slash);
+	}
+
+	// Walk up through ".." until the root, which is its own parent
+	while (currentStat.st_dev != dir.st_dev || currentStat.st_ino != dir.st_ino)
+	{
+		struct stat parentStat;
+		current += "/..";
+		if (stat(current.c_str(), &parentStat) == -1
+			|| (parentStat.st_dev == currentStat.st_dev && parentStat.st_ino == currentStat.st_ino))
+		{
+			return false;
+		}
+		currentStat = parentStat;
+	}
+	return true;
+}
+
+
+bool scanTree(const CopyJob &defaults, std::vector<CopyJob> &jobs)
+{
+	// A destination inside the source would show up in its own walk and be
+	// copied into itself over and over, so refuse before creating anything
+	struct stat sourceStat;
+	if (stat(defaults.fileIn.c_str(), &sourceStat) == 0 && S_ISDIR(sourceStat.st_mode)
+		&& insideDirectory(defaults.fileOut, sourceStat))
+	{
+		std::cerr << "Error: Destination '" << defaults.fileOut << "' is inside the source directory '"
+				  << defaults.fileIn << "'." << std::endl;
+		return false;
+	}
+	return scanDirectory(defaults, defaults.fileIn, defaults.fileOut, jobs);
+}
+
+
+/// @brief State shared by the batch workers
+struct BatchQueue
+{
+	std::vector<CopyJob> *jobs;
+	std::vector<int> results;			// copyFile() return value per job
+	std::vector<Engine> engines;		// Engine that finished each job
+	size_t next;						// Next job to hand out, guarded by lock
+	pthread_mutex_t lock;
+};
+
+
+// The worker thread function: keeps taking the next job off the shared list
+// until none are left
+static void* BatchFunction(void* arg)
+{
+	BatchQueue *queue = (BatchQueue*)arg;
+	while (true)
+	{
+		pthread_mutex_lock(&queue->lock);
+		size_t index = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+		if (index >= queue->jobs->size())
+		{
+			return NULL;
+		}
+		queue->results[index] = copyFile((*queue->jobs)[index], queue->engines[index]);
+	}
+}
+
+
+int runBatch(std::vector<CopyJob> &jobs, unsigned workers, unsigned invalid)
+{
+	// Largest first, so one big file picked up last does not leave every
+	// other worker idle while it finishes. Unreadable sources sort last and
+	// fail in copyFile() with the usual message.
+	std::vector<std::pair<off_t, size_t>> order;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		struct stat fileStat;
+		off_t size = stat(jobs[i].fileIn.c_str(), &fileStat) == 0 ? fileStat.st_size : -1;
+		order.push_back(std::make_pair(size, i));
+	}
+	std::stable_sort(order.begin(), order.end(),
+					 [](const std::pair<off_t, size_t> &a, const std::pair<off_t, size_t> &b)
+					 {
+						 return a.first > b.first;
+					 });
+	std::vector<CopyJob> sorted;
+	for (auto &entry : order)
+	{
+		sorted.push_back(jobs[entry.second]);
+	}
+	jobs.swap(sorted);
+
+	BatchQueue queue;
+	queue.jobs = &jobs;
+	queue.results.assign(jobs.size(), 1);
+	queue.engines.assign(jobs.size(), Engine::Auto);
+	queue.next = 0;
+	pthread_mutex_init(&queue.lock, NULL);
+
+	// No point starting more workers than there are files
+	std::vector<pthread_t> threads(std::min((size_t)workers, jobs.size()));
+	size_t started = 0;
+	for (; started < threads.size(); started++)
+	{
+		if (pthread_create(&threads[started], NULL, BatchFunction, &queue) != 0)
+		{
+			std::cerr << "Error: Failed to create worker thread " << started + 1 << "." << std::endl;
+			break;
+		}
+	}
+	// With no worker at all the files are still copied, just one at a time here
+	if (started == 0)
+	{
+		BatchFunction(&queue);
+	}
+	for (size_t i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&queue.lock);
+
+	// One line per file, in the order they were handed out
+	unsigned copied = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (queue.results[i] == 0)
+		{
+			std::cout << "Copied: " << jobs[i].fileIn << " -> " << jobs[i].fileOut
+					  << " (" << engineName(queue.engines[i]) << ")" << std::endl;
+			copied++;
+		}
+		else
+		{
+			std::cout << "Failed: " << jobs[i].fileIn << " -> " << jobs[i].fileOut << std::endl;
+		}
+	}
+	unsigned failed = jobs.size() - copied + invalid;
+	std::cout << "Batch: " << copied << " copied, " << failed << " failed" << std::endl;
+	if (failed > 0)
+	{
+		return 1;
+	}
+	std::cout << "Operations successful!" << std::endl;
+	return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "copyengine.h"	// for CopyOptions and Engine
+
+
+/// @brief One file to copy together with the options that apply to it
+struct CopyJob
+{
+	std::string fileIn;
+	std::string fileOut;
+	bool aMode = false;					// -a
+	bool tMode = false;					// -t
+	CopyOptions options;
+};
+
+
+// Single file copy, in proj02.cpp
+
+/// @brief Parse per-file options and file names into job, on top of what it holds
+/// @return 0 on success and 1 on error (already reported on stderr)
+int parseArguments(const std::vector<std::string> &args, CopyJob &job);
+
+/// @brief Open, copy and close one file exactly like a single proj02 run
+/// @return 0 on success and non-zero on error (already reported on stderr)
+int copyFile(const CopyJob &job, Engine &used);
+
+
+// Batch mode, in batch.cpp
+
+/// @brief Read "fileIn fileOut [options]" lines from a manifest. Blank lines and
+/// lines starting with # are skipped; every line starts from a copy of defaults.
+/// Lines that do not parse are reported and counted in invalid, not queued.
+/// @return false if the manifest itself cannot be read
+bool loadManifest(const std::string &path, const CopyJob &defaults, std::vector<CopyJob> &jobs,
+				  unsigned &invalid);
+
+/// @brief Queue every regular file below defaults.fileIn for a copy to the same
+/// relative path below defaults.fileOut, creating the directories on the way
+/// @return false if the tree cannot be walked
+bool scanTree(const CopyJob &defaults, std::vector<CopyJob> &jobs);
+
+/// @brief Copy all jobs with a pool of worker threads, largest source first.
+/// A failed file is reported and the rest carry on.
+/// @param invalid Jobs already lost while loading, counted as failures
+/// @return 0 if every file was copied and 1 otherwise
+int runBatch(std::vector<CopyJob> &jobs, unsigned workers, unsigned invalid);
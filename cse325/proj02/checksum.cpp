@@ -0,0 +1,320 @@
+#include "checksum.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <algorithm>		// for std::min, std::max
+#include <array>			// for std::array
+#include <cstring>			// for memcpy()
+#include <cstdio>			// for snprintf()
+#include <cstdlib>			// for posix_memalign(), free()
+#include <unistd.h>			// for close()
+#include <fcntl.h>			// for open(), O_DIRECT
+#include <sys/stat.h>		// for fstat()
+#ifdef __x86_64__
+#include <nmmintrin.h>		// for _mm_crc32_u64/_u8
+#endif
+
+
+// Reflected CRC-32C polynomial
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+// xxHash64 primes
+static const uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME4 = 0x85EBCA77C2B2CA63ULL;
+static const uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+// Bytes per read when checksumFile() reads the destination back
+static const size_t READBACK_CHUNK = 1 << 20;
+
+
+bool parseVerify(const std::string &name, Verify &verify)
+{
+	if (name == "crc32c")		verify = Verify::Crc32c;
+	else if (name == "xxh64")	verify = Verify::Xxh64;
+	else return false;
+	return true;
+}
+
+
+const char *verifyName(Verify verify)
+{
+	switch (verify)
+	{
+		case Verify::Crc32c:	return "crc32c";
+		case Verify::Xxh64:		return "xxh64";
+		default:				return "none";
+	}
+}
+
+
+/// @brief Byte-at-a-time CRC-32C table, built on first use. The static's
+/// initializer runs exactly once even when batch workers race to it.
+static const uint32_t *crcTable()
+{
+	static const std::array<uint32_t, 256> table = []
+	{
+		std::array<uint32_t, 256> entries;
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value >> 1) ^ (value & 1 ? CRC32C_POLY : 0);
+			}
+			entries[i] = value;
+		}
+		return entries;
+	}();
+	return table.data();
+}
+
+
+static uint32_t crcSoftware(uint32_t crc, const unsigned char *data, size_t length)
+{
+	const uint32_t *table = crcTable();
+	for (size_t i = 0; i < length; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+
+#ifdef __x86_64__
+/// @brief CRC-32C with the SSE4.2 crc32 instruction, 8 bytes per step.
+/// Compiled for SSE4.2 on its own so the rest of the program runs on any x86-64.
+__attribute__((target("sse4.2")))
+static uint32_t crcHardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+	uint64_t value = crc;
+	while (length >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, data, 8);
+		value = _mm_crc32_u64(value, word);
+		data += 8;
+		length -= 8;
+	}
+	crc = value;
+	while (length-- > 0)
+	{
+		crc = _mm_crc32_u8(crc, *data++);
+	}
+	return crc;
+}
+#endif
+
+
+static uint32_t crcUpdate(uint32_t crc, const unsigned char *data, size_t length)
+{
+#ifdef __x86_64__
+	static const bool hardware = __builtin_cpu_supports("sse4.2");
+	if (hardware)
+	{
+		return crcHardware(crc, data, length);
+	}
+#endif
+	return crcSoftware(crc, data, length);
+}
+
+
+static inline uint64_t rotl64(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const unsigned char *data)
+{
+	uint64_t value;
+	memcpy(&value, data, 8);		// xxHash is defined on little-endian words
+	return value;
+}
+
+static inline uint32_t read32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, 4);
+	return value;
+}
+
+static inline uint64_t xxhRound(uint64_t lane, uint64_t input)
+{
+	lane += input * XXH_PRIME2;
+	return rotl64(lane, 31) * XXH_PRIME1;
+}
+
+static inline uint64_t xxhMerge(uint64_t hash, uint64_t lane)
+{
+	hash ^= xxhRound(0, lane);
+	return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+
+Checksum::Checksum(Verify kind) : kindValue(kind)
+{
+	lanes[0] = XXH_PRIME1 + XXH_PRIME2;
+	lanes[1] = XXH_PRIME2;
+	lanes[2] = 0;
+	lanes[3] = -XXH_PRIME1;
+}
+
+
+void Checksum::update(const void *data, size_t length)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	totalBytes += length;
+	if (kindValue == Verify::Crc32c)
+	{
+		crc = crcUpdate(crc, bytes, length);
+		return;
+	}
+
+	// xxHash64: four independent lanes over 32-byte stripes. Chunk sizes are
+	// arbitrary, so a partial stripe is carried over to the next update().
+	if (stripeBytes > 0)
+	{
+		size_t take = std::min(length, sizeof(stripe) - stripeBytes);
+		memcpy(stripe + stripeBytes, bytes, take);
+		stripeBytes += take;
+		bytes += take;
+		length -= take;
+		if (stripeBytes < sizeof(stripe))
+		{
+			return;
+		}
+		for (int lane = 0; lane < 4; lane++)
+		{
+			lanes[lane] = xxhRound(lanes[lane], read64(stripe + lane * 8));
+		}
+		stripeBytes = 0;
+	}
+	uint64_t v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+	while (length >= 32)
+	{
+		v1 = xxhRound(v1, read64(bytes));
+		v2 = xxhRound(v2, read64(bytes + 8));
+		v3 = xxhRound(v3, read64(bytes + 16));
+		v4 = xxhRound(v4, read64(bytes + 24));
+		bytes += 32;
+		length -= 32;
+	}
+	lanes[0] = v1; lanes[1] = v2; lanes[2] = v3; lanes[3] = v4;
+	memcpy(stripe, bytes, length);
+	stripeBytes = length;
+}
+
+
+std::string Checksum::digest() const
+{
+	char hex[17];
+	if (kindValue == Verify::Crc32c)
+	{
+		snprintf(hex, sizeof(hex), "%08x", ~crc);
+		return hex;
+	}
+
+	uint64_t hash;
+	if (totalBytes >= 32)
+	{
+		hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			hash = xxhMerge(hash, lanes[lane]);
+		}
+	}
+	else
+	{
+		hash = XXH_PRIME5;
+	}
+	hash += totalBytes;
+
+	// Tail: whatever did not fill a stripe
+	const unsigned char *tail = stripe;
+	size_t remaining = stripeBytes;
+	while (remaining >= 8)
+	{
+		hash ^= xxhRound(0, read64(tail));
+		hash = rotl64(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+		tail += 8;
+		remaining -= 8;
+	}
+	if (remaining >= 4)
+	{
+		hash ^= read32(tail) * XXH_PRIME1;
+		hash = rotl64(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+		tail += 4;
+		remaining -= 4;
+	}
+	while (remaining-- > 0)
+	{
+		hash ^= *tail++ * XXH_PRIME5;
+		hash = rotl64(hash, 11) * XXH_PRIME1;
+	}
+
+	// Final avalanche
+	hash ^= hash >> 33;
+	hash *= XXH_PRIME2;
+	hash ^= hash >> 29;
+	hash *= XXH_PRIME3;
+	hash ^= hash >> 32;
+
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return hex;
+}
+
+
+bool checksumFile(const std::string &path, off_t offset, off_t length, Checksum &checksum, bool &direct)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+	direct = fd != -1;
+	if (fd == -1)
+	{
+		fd = open(path.c_str(), O_RDONLY);
+	}
+	if (fd == -1)
+	{
+		std::cerr << "Error opening destination file for verification." << std::endl;
+		return false;
+	}
+
+	// O_DIRECT reads must start on a block boundary, so read from the block
+	// holding offset and skip the bytes before it
+	struct stat fileStat;
+	size_t alignment = fstat(fd, &fileStat) == 0 && fileStat.st_blksize > 0 ? fileStat.st_blksize : 4096;
+	alignment = std::max(alignment, (size_t)4096);
+	void *memory = nullptr;
+	if (posix_memalign(&memory, alignment, READBACK_CHUNK) != 0)
+	{
+		close(fd);
+		std::cerr << "Error allocating aligned buffer." << std::endl;
+		return false;
+	}
+	unsigned char *buffer = (unsigned char *)memory;
+
+	off_t position = direct ? offset / alignment * alignment : offset;
+	off_t end = offset + length;
+	bool ok = true;
+	while (position < end)
+	{
+		ssize_t readBytes = timedPread(fd, buffer, READBACK_CHUNK, position);
+		if (readBytes <= 0)
+		{
+			std::cerr << "Error reading back destination file." << std::endl;
+			ok = false;
+			break;
+		}
+		off_t chunkStart = std::max(position, offset);
+		off_t chunkEnd = std::min(position + readBytes, end);
+		if (chunkEnd > chunkStart)
+		{
+			checksum.update(buffer + (chunkStart - position), chunkEnd - chunkStart);
+		}
+		position += readBytes;
+	}
+
+	free(memory);
+	close(fd);
+	return ok;
+}
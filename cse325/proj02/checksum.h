@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <sys/types.h>	// for off_t, size_t
+
+
+/// @brief Checksums selectable with --verify
+enum class Verify
+{
+	None,
+	Crc32c,			// CRC-32C (Castagnoli), SSE4.2 crc32 instruction where the CPU has it
+	Xxh64			// xxHash64 with seed 0 (scalar, in place of XXH3), same digest as "xxhsum -H1"
+};
+
+/// @brief Map a --verify=<name> argument to a Verify, returns false on unknown names
+bool parseVerify(const std::string &name, Verify &verify);
+
+/// @brief Name used in the checksum report
+const char *verifyName(Verify verify);
+
+
+/// @brief Streaming checksum, fed the copied data chunk by chunk in file order
+class Checksum
+{
+public:
+	explicit Checksum(Verify kind);
+
+	/// @brief Add the next length bytes of the stream
+	void update(const void *data, size_t length);
+
+	/// @brief Digest of everything added so far, as lowercase hex
+	std::string digest() const;
+
+	Verify kind() const { return kindValue; }
+
+private:
+	Verify kindValue;
+	uint32_t crc = 0xFFFFFFFF;			// CRC-32C register (pre-inverted)
+	uint64_t lanes[4];					// xxHash64 accumulators
+	unsigned char stripe[32];			// xxHash64 bytes waiting for a full 32-byte stripe
+	size_t stripeBytes = 0;
+	uint64_t totalBytes = 0;
+};
+
+
+/// @brief Checksum [offset, offset + length) of an existing file, read back with
+/// O_DIRECT so the data comes from the device rather than the page cache.
+/// Falls back to normal reads where the filesystem has no O_DIRECT.
+/// @param direct Set to whether O_DIRECT could be used
+/// @return false on any open or read error (reported on stderr)
+bool checksumFile(const std::string &path, off_t offset, off_t length, Checksum &checksum, bool &direct);
@@ -0,0 +1,450 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <sstream>			// for the one-piece copyAdaptive() report
+#include <vector>			// for buffers
+#include <chrono>			// for throughput sampling in copyAdaptive()
+#include <algorithm>		// for std::max/std::min
+#include <cerrno>			// for errno values returned by the kernel engines
+#include <climits>			// for INT_MAX
+#include <unistd.h>			// for read(), write(), lseek(), pipe()
+#include <fcntl.h>			// for fcntl() flags, splice() and posix_fadvise()
+#include <sys/sendfile.h>	// for sendfile()
+#include <sys/stat.h>		// for fstat()
+
+
+// Largest request handed to a single kernel copy call. The kernel clamps
+// these anyway, 1 GiB keeps us well clear of any ssize_t/int overflow.
+static const size_t KERNEL_CHUNK = 1 << 30;
+
+// Pipe capacity requested for the splice engine (the default is only 64 KiB)
+static const int SPLICE_PIPE_SIZE = 1 << 20;
+
+// Chunk size for --uring, -j and the other non-buffered engines when -b is
+// missing or "auto". Those engines already hide the per-call latency, so they
+// do not need the throughput probing copyAdaptive() does
+static const size_t AUTO_CHUNK = 1 << 20;
+
+// copyAdaptive() measures each buffer size over at least this many bytes and
+// calls before deciding whether doubling it again is worth it
+static const size_t ADAPT_SAMPLE_BYTES = 8 << 20;
+static const size_t ADAPT_SAMPLE_CALLS = 4;
+
+// Doubling only counts as an improvement if MB/s goes up by more than 5%,
+// anything below that is measurement noise
+static const double ADAPT_MIN_GAIN = 1.05;
+
+
+bool isRefusal(int err)
+{
+	return err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == ENOTSUP
+		|| err == EXDEV || err == EBADF;
+}
+
+
+bool parseEngine(const std::string &name, Engine &engine)
+{
+	if (name == "auto")					engine = Engine::Auto;
+	else if (name == "copy_file_range")	engine = Engine::CopyFileRange;
+	else if (name == "sendfile")		engine = Engine::Sendfile;
+	else if (name == "splice")			engine = Engine::Splice;
+	else if (name == "uring")			engine = Engine::Uring;
+	else if (name == "parallel")		engine = Engine::Parallel;
+	else if (name == "sparse")			engine = Engine::Sparse;
+	else if (name == "mmap")			engine = Engine::Mmap;
+	else if (name == "direct")			engine = Engine::Direct;
+	else if (name == "nocache")			engine = Engine::NoCache;
+	else if (name == "buffer")			engine = Engine::Buffer;
+	else return false;
+	return true;
+}
+
+
+const char *engineName(Engine engine)
+{
+	switch (engine)
+	{
+		case Engine::Auto:			return "auto";
+		case Engine::CopyFileRange:	return "copy_file_range";
+		case Engine::Sendfile:		return "sendfile";
+		case Engine::Splice:		return "splice";
+		case Engine::Uring:			return "uring";
+		case Engine::Parallel:		return "parallel";
+		case Engine::Sparse:		return "sparse";
+		case Engine::Mmap:			return "mmap";
+		case Engine::Direct:		return "direct";
+		case Engine::NoCache:		return "nocache";
+		case Engine::Buffer:		return "buffer";
+	}
+	return "unknown";
+}
+
+
+off_t pinAppendOffset(int outFD)
+{
+	int flags = fcntl(outFD, F_GETFL);
+	if (flags == -1)
+	{
+		return -1;
+	}
+
+	// Remember where the append would have started...
+	off_t base = lseek(outFD, 0, SEEK_END);
+	if (base == -1)
+	{
+		return -1;
+	}
+
+	// ...then drop O_APPEND so positioned/kernel-side writes are accepted
+	if (fcntl(outFD, F_SETFL, flags & ~O_APPEND) == -1)
+	{
+		return -1;
+	}
+	return base;
+}
+
+
+void dropCachedRange(int inFD, int outFD, off_t inOffset, off_t outOffset, off_t length)
+{
+	// Dirty pages cannot be dropped, so the destination is written back first
+	if (outFD >= 0)
+	{
+		sync_file_range(outFD, outOffset, length,
+						SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+		posix_fadvise(outFD, outOffset, length, POSIX_FADV_DONTNEED);
+	}
+	if (inFD >= 0)
+	{
+		posix_fadvise(inFD, inOffset, length, POSIX_FADV_DONTNEED);
+	}
+}
+
+
+void seekPastCopy(int inFD, int outFD, off_t inOffset, off_t outOffset)
+{
+	lseek(inFD, inOffset, SEEK_SET);
+	lseek(outFD, outOffset, SEEK_SET);
+}
+
+
+CopyStatus copyFileRange(int inFD, int outFD)
+{
+	// Some pseudo filesystems (procfs, sysfs) report a size but make
+	// copy_file_range() return 0 straight away. Treat that as a refusal.
+	struct stat inStat;
+	bool expectData = fstat(inFD, &inStat) == 0 && inStat.st_size > 0;
+	bool movedData = false;
+
+	ssize_t copied;
+	while ((copied = timedCall(StatCall::Copy, [&] { return copy_file_range(inFD, NULL, outFD, NULL, KERNEL_CHUNK, 0); })) > 0)
+	{
+		movedData = true;
+	}
+
+	if (copied == -1)
+	{
+		if (isRefusal(errno))
+		{
+			return CopyStatus::Unsupported;
+		}
+		std::cerr << "Error copying with copy_file_range." << std::endl;
+		return CopyStatus::Failed;
+	}
+	if (!movedData && expectData)
+	{
+		return CopyStatus::Unsupported;
+	}
+	return CopyStatus::Done;
+}
+
+
+CopyStatus copySendfile(int inFD, int outFD)
+{
+	ssize_t sent;
+	while ((sent = timedCall(StatCall::Copy, [&] { return sendfile(outFD, inFD, NULL, KERNEL_CHUNK); })) > 0)
+	{
+		// sendfile() advances the source offset itself, keep going until EOF
+	}
+
+	if (sent == -1)
+	{
+		if (isRefusal(errno))
+		{
+			return CopyStatus::Unsupported;
+		}
+		std::cerr << "Error copying with sendfile." << std::endl;
+		return CopyStatus::Failed;
+	}
+	return CopyStatus::Done;
+}
+
+
+CopyStatus copySplice(int inFD, int outFD)
+{
+	int pipeFDs[2];
+	if (pipe(pipeFDs) == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+	// Best effort: a bigger pipe means fewer splice round trips
+	fcntl(pipeFDs[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+
+	CopyStatus status = CopyStatus::Done;
+	ssize_t inPipe;
+	while ((inPipe = timedCall(StatCall::Copy, [&] { return splice(inFD, NULL, pipeFDs[1], NULL, INT_MAX, SPLICE_F_MOVE); })) > 0)
+	{
+		// Drain everything we just put in the pipe, the destination
+		// may accept it in several pieces
+		while (inPipe > 0)
+		{
+			ssize_t outPipe = timedCall(StatCall::Copy, [&] { return splice(pipeFDs[0], NULL, outFD, NULL, inPipe, SPLICE_F_MOVE); });
+			if (outPipe <= 0)
+			{
+				// Data is already sitting in the pipe, so there is no clean
+				// way to hand over to another engine at this point
+				std::cerr << "Error writing to destination file." << std::endl;
+				status = CopyStatus::Failed;
+				break;
+			}
+			inPipe -= outPipe;
+		}
+		if (status == CopyStatus::Failed)
+		{
+			break;
+		}
+	}
+
+	if (inPipe == -1)
+	{
+		if (isRefusal(errno))
+		{
+			status = CopyStatus::Unsupported;
+		}
+		else
+		{
+			std::cerr << "Error copying with splice." << std::endl;
+			status = CopyStatus::Failed;
+		}
+	}
+
+	close(pipeFDs[0]);
+	close(pipeFDs[1]);
+	return status;
+}
+
+
+CopyStatus copyBuffered(int inFD, int outFD, size_t buffSize, Checksum *checksum)
+{
+	// Now we handle reading and writing to the opened files
+	std::vector<char> buffer(buffSize);
+
+	ssize_t readBytes;
+	while ((readBytes = timedRead(inFD, buffer.data(), buffSize)) > 0)
+	{
+		// Write read bytes to outFD
+		ssize_t writtenBytes = timedWrite(outFD, buffer.data(), readBytes);
+
+		// Ensure bytes written are equavalent to bytes read
+		// If we find that they are not, we report the error
+		if (writtenBytes != readBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		if (checksum)
+		{
+			checksum->update(buffer.data(), readBytes);
+		}
+	}
+
+	// Now we can check the values of readBytes
+	// where we expect a positive value (error returns -1)
+	if (readBytes == -1)
+	{
+		std::cerr << "Error reading from source file." << std::endl;
+		return CopyStatus::Failed;
+	}
+	return CopyStatus::Done;
+}
+
+
+CopyStatus copyAdaptive(int inFD, int outFD, size_t maxBuffSize, Checksum *checksum)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Start from the preferred I/O size of whichever file wants bigger blocks
+	size_t startSize = 4096;
+	struct stat fileStat;
+	if (fstat(inFD, &fileStat) == 0 && fileStat.st_blksize > 0)
+	{
+		startSize = fileStat.st_blksize;
+	}
+	if (fstat(outFD, &fileStat) == 0 && (size_t)fileStat.st_blksize > startSize)
+	{
+		startSize = fileStat.st_blksize;
+	}
+	startSize = std::min(startSize, maxBuffSize);
+
+	size_t buffSize = startSize;
+	size_t bestSize = startSize;
+	double bestRate = 0.0;
+	bool growing = buffSize < maxBuffSize;
+	std::vector<char> buffer(buffSize);
+
+	size_t totalBytes = 0;
+	size_t sampleBytes = 0;
+	size_t sampleCalls = 0;
+	Clock::time_point copyStart = Clock::now();
+	Clock::time_point sampleStart = copyStart;
+
+	ssize_t readBytes;
+	while ((readBytes = timedRead(inFD, buffer.data(), buffSize)) > 0)
+	{
+		// Same short-write rule as the fixed size loop
+		ssize_t writtenBytes = timedWrite(outFD, buffer.data(), readBytes);
+		if (writtenBytes != readBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		if (checksum)
+		{
+			checksum->update(buffer.data(), readBytes);
+		}
+		totalBytes += readBytes;
+		sampleBytes += readBytes;
+		sampleCalls++;
+
+		// Once a size has been measured long enough, decide whether to keep growing
+		if (growing && sampleBytes >= ADAPT_SAMPLE_BYTES && sampleCalls >= ADAPT_SAMPLE_CALLS)
+		{
+			Clock::time_point now = Clock::now();
+			double seconds = std::chrono::duration<double>(now - sampleStart).count();
+			double rate = sampleBytes / std::max(seconds, 1e-9) / 1e6;
+
+			if (rate > bestRate * ADAPT_MIN_GAIN)
+			{
+				bestRate = rate;
+				bestSize = buffSize;
+				if (buffSize * 2 <= maxBuffSize)
+				{
+					buffSize *= 2;
+					buffer.resize(buffSize);
+				}
+				else
+				{
+					growing = false;
+				}
+			}
+			else
+			{
+				// Bigger did not help, settle on the best size seen so far
+				buffSize = bestSize;
+				growing = false;
+			}
+			sampleBytes = 0;
+			sampleCalls = 0;
+			sampleStart = now;
+		}
+	}
+
+	if (readBytes == -1)
+	{
+		std::cerr << "Error reading from source file." << std::endl;
+		return CopyStatus::Failed;
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - copyStart).count();
+	// Formatted first so the line reaches stderr in a single write
+	std::ostringstream line;
+	line << "Buffer size (auto): " << buffSize << " bytes (started at " << startSize
+		 << ", cap " << maxBuffSize << "), throughput "
+		 << totalBytes / std::max(seconds, 1e-9) / 1e6 << " MB/s\n";
+	std::cerr << line.str() << std::flush;
+	return CopyStatus::Done;
+}
+
+
+/// @brief Bytes per request for the engines that do not probe for a size. The
+/// 64 byte default only suits the original loop, so without an explicit -b the
+/// other engines get AUTO_CHUNK.
+static size_t chunkSize(const CopyOptions &options)
+{
+	if (options.autoBuff)
+	{
+		return std::min(AUTO_CHUNK, options.maxBuffSize);
+	}
+	return options.buffSizeSet ? options.buffSize : AUTO_CHUNK;
+}
+
+
+Engine runCopy(const CopyOptions &options, int inFD, int outFD, CopyStatus &status,
+			   Checksum *checksum)
+{
+	// --resume runs its own checkpointed loop instead of the fallback chain
+	if (options.resume)
+	{
+		Engine used;
+		status = copyResumable(inFD, outFD, options.checkpointFile, options.checkpointInterval,
+							   chunkSize(options), used);
+		return used;
+	}
+
+	Engine requested = options.engine;
+	if (requested == Engine::Auto && options.jobs > 1)
+	{
+		requested = Engine::Parallel;
+	}
+
+	// Build the list of engines to try, in order. Whatever was asked for,
+	// the buffered loop is the last resort because it works on anything.
+	std::vector<Engine> chain;
+	if (requested == Engine::Auto)
+	{
+		// The kernel-side engines never show us the data, so with a
+		// checksum to feed Auto means the buffered loop
+		if (!checksum)
+		{
+			chain = {Engine::CopyFileRange, Engine::Sendfile, Engine::Splice};
+		}
+	}
+	else if (requested != Engine::Buffer)
+	{
+		chain = {requested};
+	}
+	chain.push_back(Engine::Buffer);
+
+	for (Engine engine : chain)
+	{
+		switch (engine)
+		{
+			case Engine::CopyFileRange:	status = copyFileRange(inFD, outFD); break;
+			case Engine::Sendfile:		status = copySendfile(inFD, outFD); break;
+			case Engine::Splice:		status = copySplice(inFD, outFD); break;
+			case Engine::Uring:			status = copyUring(inFD, outFD, chunkSize(options)); break;
+			case Engine::Parallel:
+				status = copyParallel(inFD, outFD, chunkSize(options), options.jobs);
+				break;
+			case Engine::Sparse:		status = copySparse(inFD, outFD, chunkSize(options)); break;
+			case Engine::Mmap:			status = copyMmap(inFD, outFD, options.hugePages, checksum); break;
+			case Engine::Direct:
+				// Only an explicit -b overrides the engine's own multi-MiB default
+				status = copyDirect(inFD, outFD, options.buffSizeSet ? options.buffSize : 0, checksum);
+				break;
+			case Engine::NoCache:		status = copyNoCache(inFD, outFD, chunkSize(options), checksum); break;
+			default:
+				status = options.autoBuff ? copyAdaptive(inFD, outFD, options.maxBuffSize, checksum)
+										  : copyBuffered(inFD, outFD, options.buffSize, checksum);
+				break;
+		}
+		if (status != CopyStatus::Unsupported)
+		{
+			return engine;
+		}
+	}
+
+	// Buffered copy never reports Unsupported, but be explicit about it
+	status = CopyStatus::Failed;
+	return Engine::Buffer;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sys/types.h>	// for off_t, size_t
+#include "checksum.h"	// for --verify
+
+
+/// @brief Copy strategies selectable with --engine
+enum class Engine
+{
+	Auto,			// Try the kernel-side engines in order, then fall back to Buffer
+	CopyFileRange,	// copy_file_range(): in-kernel copy, may reflink on CoW filesystems
+	Sendfile,		// sendfile(): page cache of the source straight to the destination
+	Splice,			// splice(): source -> pipe -> destination, no user-space copy
+	Uring,			// io_uring: several linked read->write pairs in flight at once
+	Parallel,		// pread()/pwrite() over disjoint offset ranges, one thread each
+	Sparse,			// Copies only the data extents found with SEEK_DATA/SEEK_HOLE
+	Mmap,			// memcpy() between mmap()ed windows of both files
+	Direct,			// O_DIRECT reads/writes through a block aligned buffer
+	NoCache,		// Buffered loop that evicts what it copied with POSIX_FADV_DONTNEED
+	Buffer			// read()/write() through a user-space buffer (the original loop)
+};
+
+/// @brief Outcome of one engine attempt
+enum class CopyStatus
+{
+	Done,			// Source was copied through to EOF
+	Unsupported,	// Kernel refused this path (EINVAL, EXDEV, ...), caller may fall back
+	Failed			// Hard I/O error, already reported on stderr
+};
+
+
+/// @brief Tunables shared by the engines, filled in from the command line
+struct CopyOptions
+{
+	Engine engine = Engine::Auto;		// --engine
+	size_t buffSize = 64;				// -b <int>, bytes per read()/write() in the buffered loop
+	bool buffSizeSet = false;			// -b <int> was given, the other engines use it as their chunk too
+	bool autoBuff = false;				// -b auto, size the buffer from st_blksize and throughput
+	size_t maxBuffSize = 16 << 20;		// --max-buffer <int>, upper bound for -b auto
+	unsigned jobs = 1;					// -j <int>, threads used by the parallel engine
+	bool hugePages = false;				// --hugepage, MADV_HUGEPAGE on the mmap windows
+	Verify verify = Verify::None;		// --verify=<name>, checksum the data as it is copied
+	bool verifyReadback = false;		// --verify-readback, compare with an O_DIRECT re-read
+	bool resume = false;				// --resume, keep a checkpoint next to the destination
+	off_t checkpointInterval = 64 << 20;	// --checkpoint <int>, bytes copied between checkpoints
+	std::string checkpointFile;			// Where --resume keeps it, set per destination
+};
+
+
+/// @brief Map an --engine argument to an Engine, returns false on unknown names
+bool parseEngine(const std::string &name, Engine &engine);
+
+/// @brief Human readable engine name used in the "Engine used" report
+const char *engineName(Engine engine);
+
+/// @brief Errors that mean "this kernel/filesystem does not do that", as opposed
+/// to a real I/O failure. These are the cases where falling back is safe.
+bool isRefusal(int err);
+
+/// @brief Fix the write position of an O_APPEND descriptor at the current end of file
+/// and clear O_APPEND, so engines that reject append-mode targets can still be used.
+/// @return The pinned offset, or -1 on error
+off_t pinAppendOffset(int outFD);
+
+/// @brief Write back [outOffset, outOffset + length) of outFD and drop it, and the
+/// matching source range of inFD, from the page cache. Pass -1 to skip a side.
+void dropCachedRange(int inFD, int outFD, off_t inOffset, off_t outOffset, off_t length);
+
+/// @brief Move inFD/outFD to inOffset/outOffset. The engines that copy with
+/// positioned I/O call this once they are done, to honour the offset contract below.
+void seekPastCopy(int inFD, int outFD, off_t inOffset, off_t outOffset);
+
+// Individual engines. All of them continue from the current file offsets of
+// inFD/outFD and leave both offsets at the end of the copied data, so a
+// partially completed engine can be followed by another one.
+// The ones that move data through user space take an optional Checksum and
+// feed it every chunk, in file order, right after it is written.
+CopyStatus copyFileRange(int inFD, int outFD);
+CopyStatus copySendfile(int inFD, int outFD);
+CopyStatus copySplice(int inFD, int outFD);
+CopyStatus copyBuffered(int inFD, int outFD, size_t buffSize, Checksum *checksum = nullptr);
+
+/// @brief Buffered copy that starts at the larger st_blksize of the two files and
+/// doubles the buffer while measured MB/s keeps improving, up to maxBuffSize.
+/// The chosen size and overall throughput are reported on stderr.
+CopyStatus copyAdaptive(int inFD, int outFD, size_t maxBuffSize, Checksum *checksum = nullptr);
+
+/// @brief Pipelined copy through io_uring (uringengine.cpp). Keeps a ring of
+/// registered chunkSize buffers, each with a read linked to the write of the
+/// same chunk at its own destination offset. Short reads and short writes are
+/// resubmitted for the remainder. Needs a regular source file.
+CopyStatus copyUring(int inFD, int outFD, size_t chunkSize);
+
+/// @brief Range-parallel copy (parallelengine.cpp). Pre-sizes the destination with
+/// fallocate()/ftruncate(), splits the source into one range per job and copies
+/// each range with pread()/pwrite() on its own thread, sharing inFD/outFD.
+/// Needs a regular source file.
+CopyStatus copyParallel(int inFD, int outFD, size_t buffSize, unsigned jobs);
+
+/// @brief Hole-preserving copy (sparseengine.cpp). Walks the source's data extents
+/// with lseek(SEEK_DATA/SEEK_HOLE), copies only those and leaves holes unwritten,
+/// then sets the destination's logical length. Reports transferred vs logical bytes.
+CopyStatus copySparse(int inFD, int outFD, size_t buffSize);
+
+/// @brief Copy [inOffset, inOffset + length) to outOffset without touching the file
+/// offsets (sparseengine.cpp). Starts with copy_file_range() and switches to
+/// pread()/pwrite() through buffer for good (useKernel = false) the first time the
+/// kernel refuses it.
+/// @return false on a hard I/O error (reported on stderr)
+bool copyExtent(int inFD, int outFD, off_t inOffset, off_t outOffset, off_t length,
+				std::vector<char> &buffer, size_t buffSize, bool &useKernel);
+
+/// @brief Memory-mapped copy (mmapengine.cpp). Maps the source read-only with
+/// MADV_SEQUENTIAL and the pre-sized destination read/write (outFD must be
+/// O_RDWR), one 64 MiB window at a time. Finished windows are written back and
+/// evicted so at most two windows sit in the page cache. Reports MB/s on stderr.
+CopyStatus copyMmap(int inFD, int outFD, bool hugePages, Checksum *checksum = nullptr);
+
+/// @brief Cache-bypassing copy (directengine.cpp). Switches both descriptors to
+/// O_DIRECT and copies through a posix_memalign()ed buffer of buffSize (8 MiB if
+/// 0) rounded up to whole logical blocks. The unaligned tail is written with O_DIRECT turned off. If the
+/// destination offset cannot be aligned with the source (-a onto an odd-sized
+/// file) only the source is read directly and the destination is evicted instead.
+CopyStatus copyDirect(int inFD, int outFD, size_t buffSize, Checksum *checksum = nullptr);
+
+/// @brief Lighter alternative to copyDirect(): the plain buffered loop, but every
+/// 8 MiB the copied range is written back and dropped with POSIX_FADV_DONTNEED
+CopyStatus copyNoCache(int inFD, int outFD, size_t buffSize, Checksum *checksum = nullptr);
+
+/// @brief Resumable copy (resumeengine.cpp). Copies in checkpointInterval sized
+/// chunks; after each one the destination is fdatasync()ed and the durable
+/// offset recorded in the checkpoint file, itself fdatasync()ed. If a valid
+/// checkpoint for the same source exists and the tail of its last chunk matches
+/// in both files, the copy continues from there, otherwise it starts over.
+/// The checkpoint is removed once the copy is complete.
+/// @param used Set to the engine that moved the data
+CopyStatus copyResumable(int inFD, int outFD, const std::string &checkpointPath,
+						 off_t checkpointInterval, size_t buffSize, Engine &used);
+
+/// @brief Checkpoint file --resume keeps for a destination
+std::string checkpointPath(const std::string &fileOut);
+
+/// @brief What is at a destination's checkpoint path, from inspectCheckpoint()
+enum class CheckpointState
+{
+	None,		// No file there
+	Foreign,	// A file that is not a --resume checkpoint, never to be touched
+	Stale,		// A checkpoint for another source (or another version of it)
+	Matching	// A checkpoint for this source, as it is now
+};
+
+/// @brief Read the checkpoint at checkpointPath without changing it, and compare
+/// it with the size and modification time of the source open as inFD
+CheckpointState inspectCheckpoint(const std::string &checkpointPath, int inFD);
+
+/// @brief Run the requested engine, falling back along
+/// copy_file_range -> sendfile -> splice -> buffer whenever the kernel refuses a path.
+/// Engine::Uring is never picked by Auto, it falls straight back to the buffer.
+/// With options.jobs > 1, Auto means Engine::Parallel. With options.resume the
+/// copy goes through copyResumable() instead.
+/// @param status Set to the final status of the copy
+/// @param checksum If set, Auto goes straight to the buffered loop (the kernel-side
+/// engines never show us the data) and the copied bytes are fed to it
+/// @return The engine that finished (or failed) the copy
+Engine runCopy(const CopyOptions &options, int inFD, int outFD, CopyStatus &status,
+			   Checksum *checksum = nullptr);
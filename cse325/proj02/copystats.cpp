@@ -0,0 +1,182 @@
+#include "copystats.h"
+
+#include <iostream>
+#include <string>			// for std::to_string()
+#include <atomic>			// for counters shared by copy threads
+#include <sys/resource.h>	// for getrusage()
+
+
+// Latency buckets are powers of two in ns: bucket b holds calls that took
+// [2^b, 2^(b+1)) ns, the last one everything from ~1 s up
+static const unsigned STAT_BUCKETS = 31;
+static const unsigned STAT_KINDS = (unsigned)StatCall::Count;
+static const char *STAT_NAMES[STAT_KINDS] = {"read", "write", "copy", "sync"};
+
+bool statsActive = false;
+
+
+/// @brief Counters for one kind of call. Relaxed atomics: the parallel engine
+/// and batch workers record from several threads, nobody reads until the end.
+struct CallStats
+{
+	std::atomic<uint64_t> calls{0};
+	std::atomic<uint64_t> bytes{0};
+	std::atomic<uint64_t> nanoseconds{0};
+	std::atomic<uint64_t> histogram[STAT_BUCKETS];
+};
+
+static CallStats callStats[STAT_KINDS];
+static std::atomic<uint64_t> filesCopied{0};
+static std::atomic<uint64_t> bytesCopied{0};
+static std::atomic<uint64_t> checkpoints{0};
+static std::atomic<uint64_t> checkpointInterval{0};
+static uint64_t wallStart = 0;
+
+
+void enableStats()
+{
+	statsActive = true;
+	wallStart = statStart();
+}
+
+
+void recordCall(StatCall call, uint64_t start, ssize_t result)
+{
+	uint64_t elapsed = statStart() - start;
+	unsigned bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+	if (bucket >= STAT_BUCKETS)
+	{
+		bucket = STAT_BUCKETS - 1;
+	}
+
+	CallStats &stats = callStats[(unsigned)call];
+	stats.calls.fetch_add(1, std::memory_order_relaxed);
+	stats.nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+	stats.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	if (result > 0)
+	{
+		stats.bytes.fetch_add(result, std::memory_order_relaxed);
+	}
+}
+
+
+void recordFile(off_t bytes)
+{
+	filesCopied.fetch_add(1, std::memory_order_relaxed);
+	bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+void recordCheckpoint(off_t interval)
+{
+	checkpoints.fetch_add(1, std::memory_order_relaxed);
+	checkpointInterval.store(interval, std::memory_order_relaxed);
+}
+
+
+/// @brief Short label for a power-of-two duration in ns
+static std::string durationLabel(uint64_t ns)
+{
+	if (ns < 1000)
+	{
+		return std::to_string(ns) + " ns";
+	}
+	if (ns < 1000000)
+	{
+		return std::to_string(ns / 1000) + " us";
+	}
+	if (ns < 1000000000)
+	{
+		return std::to_string(ns / 1000000) + " ms";
+	}
+	return std::to_string(ns / 1000000000) + " s";
+}
+
+
+void printStats(StatFormat format)
+{
+	double wall = (statStart() - wallStart) / 1e9;
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+	double system = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	uint64_t bytes = bytesCopied.load();
+	uint64_t files = filesCopied.load();
+	double throughput = wall > 0 ? bytes / wall / 1e6 : 0;
+
+	if (format == StatFormat::Json)
+	{
+		// One line, so it can be picked out of stderr with grep/tail
+		std::cerr << "{\"bytes\":" << bytes << ",\"files\":" << files << ",\"wall_s\":" << wall
+				  << ",\"cpu_user_s\":" << user << ",\"cpu_sys_s\":" << system
+				  << ",\"mb_per_s\":" << throughput << ",\"calls\":{";
+		for (unsigned kind = 0; kind < STAT_KINDS; kind++)
+		{
+			CallStats &stats = callStats[kind];
+			std::cerr << (kind ? "," : "") << "\"" << STAT_NAMES[kind] << "\":{\"count\":" << stats.calls
+					  << ",\"bytes\":" << stats.bytes << ",\"total_ns\":" << stats.nanoseconds
+					  << ",\"histogram_ns\":[";
+			// Only the used buckets, as [lower bound in ns, calls]
+			bool first = true;
+			for (unsigned bucket = 0; bucket < STAT_BUCKETS; bucket++)
+			{
+				if (stats.histogram[bucket])
+				{
+					std::cerr << (first ? "" : ",") << "[" << (1ull << bucket) << ","
+							  << stats.histogram[bucket] << "]";
+					first = false;
+				}
+			}
+			std::cerr << "]}";
+		}
+		std::cerr << "},\"checkpoints\":{\"count\":" << checkpoints << ",\"interval\":"
+				  << checkpointInterval << "}}" << std::endl;
+		return;
+	}
+
+	std::cerr << "Stats: " << bytes << " bytes in " << files << " file" << (files == 1 ? "" : "s")
+			  << ", wall " << wall << " s, cpu " << user + system << " s (user " << user
+			  << ", sys " << system << "), " << throughput << " MB/s" << std::endl;
+	for (unsigned kind = 0; kind < STAT_KINDS; kind++)
+	{
+		CallStats &stats = callStats[kind];
+		uint64_t calls = stats.calls;
+		std::cerr << "  " << STAT_NAMES[kind] << ": " << calls << " calls, " << stats.bytes << " bytes";
+		if (calls)
+		{
+			std::cerr << ", avg " << stats.nanoseconds / calls / 1000.0 << " us";
+		}
+		std::cerr << std::endl;
+	}
+	if (checkpoints)
+	{
+		// Their cost is the sync line above
+		std::cerr << "  checkpoints: " << checkpoints << ", every " << checkpointInterval << " bytes" << std::endl;
+	}
+
+	// Latency histogram: one row per bucket any kind of call landed in
+	std::cerr << "  latency";
+	for (unsigned kind = 0; kind < STAT_KINDS; kind++)
+	{
+		std::cerr << "\t" << STAT_NAMES[kind];
+	}
+	std::cerr << std::endl;
+	for (unsigned bucket = 0; bucket < STAT_BUCKETS; bucket++)
+	{
+		uint64_t rowTotal = 0;
+		for (unsigned kind = 0; kind < STAT_KINDS; kind++)
+		{
+			rowTotal += callStats[kind].histogram[bucket];
+		}
+		if (rowTotal == 0)
+		{
+			continue;
+		}
+		std::cerr << "  >= " << durationLabel(1ull << bucket);
+		for (unsigned kind = 0; kind < STAT_KINDS; kind++)
+		{
+			std::cerr << "\t" << callStats[kind].histogram[bucket];
+		}
+		std::cerr << std::endl;
+	}
+}
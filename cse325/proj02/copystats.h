@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cerrno>		// for keeping errno across the timing code
+#include <ctime>		// for clock_gettime()
+#include <unistd.h>		// for read(), write(), pread(), pwrite()
+
+
+/// @brief Kinds of timed calls reported by --stats
+enum class StatCall
+{
+	Read,			// read()/pread() and io_uring reads
+	Write,			// write()/pwrite() and io_uring writes
+	Copy,			// One in-kernel or in-memory transfer: copy_file_range(), sendfile(), splice(), an mmap window
+	Sync,			// fdatasync() of the destination or the --resume checkpoint
+	Count
+};
+
+/// @brief Output format of the --stats report
+enum class StatFormat
+{
+	Human,
+	Json
+};
+
+
+// Set once by enableStats(), before any copy starts
+extern bool statsActive;
+
+/// @brief Turn on call timing and start the wall clock. Until then every
+/// timed call below costs one extra branch.
+void enableStats();
+
+/// @brief Whether --stats was given
+inline bool statsEnabled()
+{
+	return statsActive;
+}
+
+/// @brief Start time of a call in ns, or 0 when stats are off
+inline uint64_t statStart()
+{
+	if (!statsEnabled())
+	{
+		return 0;
+	}
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/// @brief Count one call that started at start (from statStart()) and returned result
+void recordCall(StatCall call, uint64_t start, ssize_t result);
+
+/// @brief Count one copied file of the given size
+void recordFile(off_t bytes);
+
+/// @brief Count one --resume checkpoint written every interval bytes
+void recordCheckpoint(off_t interval);
+
+/// @brief Print the report to stderr
+void printStats(StatFormat format);
+
+
+/// @brief Run call() and, when --stats is on, count and time it as kind.
+/// errno is left as call() set it.
+template <typename Call>
+inline ssize_t timedCall(StatCall kind, Call call)
+{
+	uint64_t start = statStart();
+	ssize_t result = call();
+	if (start)
+	{
+		int savedErrno = errno;
+		recordCall(kind, start, result);
+		errno = savedErrno;
+	}
+	return result;
+}
+
+/// @brief read() that is counted and timed when --stats is on
+inline ssize_t timedRead(int fd, void *buffer, size_t count)
+{
+	return timedCall(StatCall::Read, [&] { return read(fd, buffer, count); });
+}
+
+/// @brief write() that is counted and timed when --stats is on
+inline ssize_t timedWrite(int fd, const void *buffer, size_t count)
+{
+	return timedCall(StatCall::Write, [&] { return write(fd, buffer, count); });
+}
+
+/// @brief pread() that is counted and timed when --stats is on
+inline ssize_t timedPread(int fd, void *buffer, size_t count, off_t offset)
+{
+	return timedCall(StatCall::Read, [&] { return pread(fd, buffer, count, offset); });
+}
+
+/// @brief pwrite() that is counted and timed when --stats is on
+inline ssize_t timedPwrite(int fd, const void *buffer, size_t count, off_t offset)
+{
+	return timedCall(StatCall::Write, [&] { return pwrite(fd, buffer, count, offset); });
+}
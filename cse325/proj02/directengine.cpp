@@ -0,0 +1,210 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <vector>			// for the nocache buffer
+#include <algorithm>		// for std::max
+#include <cerrno>			// for errno
+#include <cstdlib>			// for posix_memalign(), free()
+#include <unistd.h>			// for read(), write(), lseek()
+#include <fcntl.h>			// for fcntl(), O_DIRECT, AT_EMPTY_PATH
+#include <sys/stat.h>		// for fstat(), statx()
+
+
+// --nocache drops what it has copied from the page cache every this many bytes
+static const off_t NOCACHE_STRIDE = 8 << 20;
+
+// --direct transfer size without -b. Every O_DIRECT request goes to the device
+// synchronously, so it takes requests of several MiB to keep it busy.
+static const size_t DIRECT_CHUNK = 8 << 20;
+
+
+/// @brief Alignment O_DIRECT needs for buffers, offsets and lengths on this file.
+/// statx() knows the real value on Linux 6.1+; st_blksize is a safe multiple of
+/// the logical block size everywhere else.
+static size_t directAlignment(int fd)
+{
+	size_t alignment = 0;
+#ifdef STATX_DIOALIGN
+	struct statx info;
+	if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &info) == 0 && (info.stx_mask & STATX_DIOALIGN))
+	{
+		alignment = std::max(info.stx_dio_mem_align, info.stx_dio_offset_align);
+	}
+#endif
+	if (alignment == 0)
+	{
+		struct stat fileStat;
+		alignment = fstat(fd, &fileStat) == 0 && fileStat.st_blksize > 0 ? fileStat.st_blksize : 4096;
+	}
+	return alignment;
+}
+
+
+/// @brief Turn O_DIRECT on or off for an already open descriptor
+static bool setDirect(int fd, bool enable)
+{
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1)
+	{
+		return false;
+	}
+	flags = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+	return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+
+CopyStatus copyDirect(int inFD, int outFD, size_t buffSize, Checksum *checksum)
+{
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+
+	// Every read starts on a block boundary of the source, so the destination
+	// can only bypass the cache too if its offset lines up the same way.
+	// Otherwise (typically -a onto an odd-sized file) it gets the fadvise
+	// treatment after each write instead.
+	size_t alignment = std::max(directAlignment(inFD), directAlignment(outFD));
+	bool directOut = (outBase - inBase) % alignment == 0;
+	if (inBase % alignment != 0 || !setDirect(inFD, true))
+	{
+		return CopyStatus::Unsupported;
+	}
+	if (directOut && !setDirect(outFD, true))
+	{
+		setDirect(inFD, false);
+		return CopyStatus::Unsupported;
+	}
+
+	// One buffer, aligned and sized to whole blocks (at least one)
+	if (buffSize == 0)
+	{
+		buffSize = DIRECT_CHUNK;
+	}
+	size_t chunk = std::max(alignment, (buffSize + alignment - 1) / alignment * alignment);
+	void *memory = nullptr;
+	if (posix_memalign(&memory, alignment, chunk) != 0)
+	{
+		setDirect(inFD, false);
+		setDirect(outFD, false);
+		std::cerr << "Error allocating aligned buffer." << std::endl;
+		return CopyStatus::Failed;
+	}
+	char *buffer = (char *)memory;
+
+	CopyStatus status = CopyStatus::Done;
+	off_t copied = 0;
+	off_t released = 0;
+	ssize_t readBytes;
+	while ((readBytes = timedRead(inFD, buffer, chunk)) > 0)
+	{
+		// Only the very last read can be short. Its whole blocks still go out
+		// directly, the unaligned tail is written through the page cache.
+		size_t alignedBytes = directOut ? readBytes / alignment * alignment : readBytes;
+		size_t tailBytes = readBytes - alignedBytes;
+
+		if (alignedBytes > 0 && timedWrite(outFD, buffer, alignedBytes) != (ssize_t)alignedBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			status = CopyStatus::Failed;
+			break;
+		}
+		if (tailBytes > 0)
+		{
+			setDirect(outFD, false);
+			directOut = false;
+			if (timedWrite(outFD, buffer + alignedBytes, tailBytes) != (ssize_t)tailBytes)
+			{
+				std::cerr << "Error writing to destination file." << std::endl;
+				status = CopyStatus::Failed;
+				break;
+			}
+		}
+		if (checksum)
+		{
+			checksum->update(buffer, readBytes);
+		}
+		copied += readBytes;
+
+		// A destination that is not bypassing the cache is evicted in strides
+		if (!directOut && copied - released >= NOCACHE_STRIDE)
+		{
+			dropCachedRange(-1, outFD, 0, outBase + released, copied - released);
+			released = copied;
+		}
+	}
+	if (status == CopyStatus::Done && copied > released)
+	{
+		dropCachedRange(-1, outFD, 0, outBase + released, copied - released);
+	}
+
+	if (readBytes == -1 && status == CopyStatus::Done)
+	{
+		// EINVAL before anything moved means the filesystem takes O_DIRECT in
+		// fcntl() but rejects the actual I/O, which is safe to fall back from
+		if (errno == EINVAL && copied == 0)
+		{
+			status = CopyStatus::Unsupported;
+		}
+		else
+		{
+			std::cerr << "Error reading from source file." << std::endl;
+			status = CopyStatus::Failed;
+		}
+	}
+
+	setDirect(inFD, false);
+	setDirect(outFD, false);
+	free(memory);
+	return status;
+}
+
+
+CopyStatus copyNoCache(int inFD, int outFD, size_t buffSize, Checksum *checksum)
+{
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+
+	std::vector<char> buffer(buffSize);
+	off_t copied = 0;
+	off_t released = 0;
+
+	ssize_t readBytes;
+	while ((readBytes = timedRead(inFD, buffer.data(), buffSize)) > 0)
+	{
+		// Same short-write rule as the buffered loop
+		ssize_t writtenBytes = timedWrite(outFD, buffer.data(), readBytes);
+		if (writtenBytes != readBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		if (checksum)
+		{
+			checksum->update(buffer.data(), readBytes);
+		}
+		copied += readBytes;
+
+		// Every stride, write back and evict what has been copied since the last one
+		if (copied - released >= NOCACHE_STRIDE)
+		{
+			dropCachedRange(inFD, outFD, inBase + released, outBase + released, copied - released);
+			released = copied;
+		}
+	}
+
+	if (readBytes == -1)
+	{
+		std::cerr << "Error reading from source file." << std::endl;
+		return CopyStatus::Failed;
+	}
+	dropCachedRange(inFD, outFD, inBase + released, outBase + released, copied - released);
+	return CopyStatus::Done;
+}
@@ -0,0 +1,143 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <sstream>			// for the one-piece report line
+#include <chrono>			// for the throughput report
+#include <algorithm>		// for std::min/std::max
+#include <cstring>			// for memcpy()
+#include <unistd.h>			// for lseek(), ftruncate(), sysconf()
+#include <fcntl.h>			// for sync_file_range()
+#include <sys/mman.h>		// for mmap(), madvise(), munmap()
+#include <sys/stat.h>		// for fstat()
+
+
+// Bytes mapped and copied per step. Large enough to amortise the mmap/munmap
+// and fault setup, small enough that two windows of page cache stay cheap.
+static const off_t MMAP_WINDOW = 64 << 20;
+
+
+/// @brief Map [offset, offset + length) of a file. mmap() needs a page aligned
+/// file offset, so the mapping may start a little earlier; skew says by how much.
+static char *mapWindow(int fd, off_t offset, off_t length, int prot, off_t &skew)
+{
+	static const off_t pageSize = sysconf(_SC_PAGESIZE);
+	skew = offset % pageSize;
+	void *address = mmap(NULL, length + skew, prot, MAP_SHARED, fd, offset - skew);
+	return address == MAP_FAILED ? nullptr : (char *)address;
+}
+
+
+CopyStatus copyMmap(int inFD, int outFD, bool hugePages, Checksum *checksum)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point copyStart = Clock::now();
+
+	// Both ends must be regular files to be mapped
+	struct stat inStat;
+	struct stat outStat;
+	if (fstat(inFD, &inStat) == -1 || !S_ISREG(inStat.st_mode)
+		|| fstat(outFD, &outStat) == -1 || !S_ISREG(outStat.st_mode))
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t total = inStat.st_size > inBase ? inStat.st_size - inBase : 0;
+
+	// Stores through a mapping cannot grow a file, so size it up front
+	if (outStat.st_size < outBase + total && ftruncate(outFD, outBase + total) == -1)
+	{
+		std::cerr << "Error resizing destination file." << std::endl;
+		return CopyStatus::Failed;
+	}
+
+	off_t done = 0;
+	while (done < total)
+	{
+		off_t length = std::min(MMAP_WINDOW, total - done);
+		off_t inSkew;
+		off_t outSkew;
+
+		char *source = mapWindow(inFD, inBase + done, length, PROT_READ, inSkew);
+		if (!source)
+		{
+			// Nothing written yet means another engine can still take over
+			if (done == 0)
+			{
+				return CopyStatus::Unsupported;
+			}
+			std::cerr << "Error mapping source file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		// The kernel reads ahead aggressively and frees behind us
+		madvise(source, length + inSkew, MADV_SEQUENTIAL);
+
+		char *destination = mapWindow(outFD, outBase + done, length, PROT_READ | PROT_WRITE, outSkew);
+		if (!destination)
+		{
+			munmap(source, length + inSkew);
+			// A write-only descriptor (EACCES) cannot be mapped for writing
+			if (done == 0)
+			{
+				return CopyStatus::Unsupported;
+			}
+			std::cerr << "Error mapping destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		if (hugePages)
+		{
+			// Best effort: only honoured where the filesystem supports large folios
+			madvise(source, length + inSkew, MADV_HUGEPAGE);
+			madvise(destination, length + outSkew, MADV_HUGEPAGE);
+		}
+
+		// Page faults on both mappings happen in here, so it is timed as one copy call
+		uint64_t windowStart = statStart();
+		memcpy(destination + outSkew, source + inSkew, length);
+		if (windowStart)
+		{
+			recordCall(StatCall::Copy, windowStart, length);
+		}
+		// The source window was just read, so it is still in cache
+		if (checksum)
+		{
+			checksum->update(source + inSkew, length);
+		}
+
+		// Window finished: drop our page table entries for it straight away
+		madvise(source, length + inSkew, MADV_DONTNEED);
+		munmap(source, length + inSkew);
+		munmap(destination, length + outSkew);
+
+		// Start writeback of this window, then wait for and evict the previous
+		// one. That keeps at most two windows of the copy in the page cache.
+		sync_file_range(outFD, outBase + done, length, SYNC_FILE_RANGE_WRITE);
+		if (done > 0)
+		{
+			dropCachedRange(inFD, outFD, inBase + done - MMAP_WINDOW, outBase + done - MMAP_WINDOW,
+							MMAP_WINDOW);
+		}
+		done += length;
+	}
+	if (total > 0)
+	{
+		off_t last = (total - 1) / MMAP_WINDOW * MMAP_WINDOW;
+		dropCachedRange(inFD, outFD, inBase + last, outBase + last, total - last);
+	}
+
+	seekPastCopy(inFD, outFD, inBase + total, outBase + total);
+
+	double seconds = std::chrono::duration<double>(Clock::now() - copyStart).count();
+	// One write, batch workers may be reporting at the same time
+	std::ostringstream line;
+	line << "mmap: " << total << " bytes in " << seconds << " s, throughput "
+		 << total / std::max(seconds, 1e-9) / 1e6 << " MB/s ("
+		 << (MMAP_WINDOW >> 20) << " MiB windows)\n";
+	std::cerr << line.str() << std::flush;
+	return CopyStatus::Done;
+}
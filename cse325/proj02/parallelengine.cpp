@@ -0,0 +1,149 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <vector>			// for buffers and worker bookkeeping
+#include <algorithm>		// for std::min
+#include <cerrno>			// for errno values from fallocate()
+#include <pthread.h>		// for the worker threads
+#include <unistd.h>			// for pread(), pwrite(), lseek(), ftruncate()
+#include <fcntl.h>			// for fallocate()
+#include <sys/stat.h>		// for fstat()
+
+
+// Range boundaries are rounded to this so no two threads ever write into the
+// same filesystem block, which would otherwise serialise them in the kernel
+static const off_t RANGE_ALIGN = 1 << 16;
+
+
+/// @brief Work description and result for one copy thread
+struct RangeJob
+{
+	int inFD;
+	int outFD;
+	off_t inBase;			// Source offset the whole copy starts at
+	off_t outBase;			// Destination offset the whole copy starts at
+	off_t start;			// This thread's range, relative to the bases
+	off_t end;
+	size_t buffSize;
+	CopyStatus status;
+};
+
+
+// The worker thread function: copies [start, end) with positioned I/O, so the
+// shared descriptors' file offsets are never touched
+static void* RangeFunction(void* arg)
+{
+	RangeJob *job = (RangeJob*)arg;
+	std::vector<char> buffer(job->buffSize);
+
+	off_t offset = job->start;
+	while (offset < job->end)
+	{
+		size_t want = std::min((off_t)job->buffSize, job->end - offset);
+		ssize_t readBytes = timedPread(job->inFD, buffer.data(), want, job->inBase + offset);
+		if (readBytes == -1)
+		{
+			std::cerr << "Error reading from source file." << std::endl;
+			job->status = CopyStatus::Failed;
+			return NULL;
+		}
+		if (readBytes == 0)
+		{
+			// The destination was pre-sized from the old length
+			std::cerr << "Error: Source file shrank during the copy." << std::endl;
+			job->status = CopyStatus::Failed;
+			return NULL;
+		}
+
+		// Same short-write rule as the buffered loop
+		ssize_t writtenBytes = timedPwrite(job->outFD, buffer.data(), readBytes, job->outBase + offset);
+		if (writtenBytes != readBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			job->status = CopyStatus::Failed;
+			return NULL;
+		}
+		offset += readBytes;
+	}
+
+	job->status = CopyStatus::Done;
+	return NULL;
+}
+
+
+CopyStatus copyParallel(int inFD, int outFD, size_t buffSize, unsigned jobs)
+{
+	// Ranges only make sense for a regular file with a known size
+	struct stat inStat;
+	if (fstat(inFD, &inStat) == -1 || !S_ISREG(inStat.st_mode))
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t total = inStat.st_size > inBase ? inStat.st_size - inBase : 0;
+
+	// Pre-size the destination so the threads never race to extend it.
+	// fallocate() also reserves the blocks; not every filesystem has it,
+	// ftruncate() still sets the final length in that case.
+	if (total > 0)
+	{
+		if (fallocate(outFD, 0, outBase, total) == -1 && errno != EOPNOTSUPP && errno != ENOSYS)
+		{
+			std::cerr << "Error reserving space in destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		struct stat outStat;
+		if (fstat(outFD, &outStat) == -1
+			|| (outStat.st_size < outBase + total && ftruncate(outFD, outBase + total) == -1))
+		{
+			std::cerr << "Error resizing destination file." << std::endl;
+			return CopyStatus::Failed;
+		}
+	}
+
+	// Split the file into (at most) one aligned range per thread
+	off_t rangeSize = (total + jobs - 1) / jobs;
+	rangeSize = (rangeSize + RANGE_ALIGN - 1) / RANGE_ALIGN * RANGE_ALIGN;
+	std::vector<RangeJob> ranges;
+	for (off_t start = 0; start < total; start += rangeSize)
+	{
+		RangeJob job = {inFD, outFD, inBase, outBase, start, std::min(start + rangeSize, total),
+						buffSize, CopyStatus::Failed};
+		ranges.push_back(job);
+	}
+
+	// Create and run the worker threads
+	std::vector<pthread_t> threads(ranges.size());
+	size_t started = 0;
+	for (; started < ranges.size(); started++)
+	{
+		if (pthread_create(&threads[started], NULL, RangeFunction, &ranges[started]) != 0)
+		{
+			std::cerr << "Error: Failed to create copy thread " << started + 1 << "." << std::endl;
+			break;
+		}
+	}
+
+	// Wait for every thread we managed to start before looking at results
+	CopyStatus status = started == ranges.size() ? CopyStatus::Done : CopyStatus::Failed;
+	for (size_t i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+		if (ranges[i].status != CopyStatus::Done)
+		{
+			status = CopyStatus::Failed;
+		}
+	}
+
+	if (status == CopyStatus::Done)
+	{
+		seekPastCopy(inFD, outFD, inBase + total, outBase + total);
+	}
+	return status;
+}
@@ -1,93 +1,258 @@
 #include <iostream>
+#include <climits>	// for INT_MAX
 #include <unistd.h>	// for access(), open() and close()
 #include <fcntl.h> 	// for syscall flags
-#include <vector>	// for buffers
+#include <sys/stat.h>	// for fstat()
+#include "copyengine.h"	// for the copy engines
+#include "batch.h"		// for CopyJob and the batch modes
+#include "copystats.h"	// for --stats
 
 
-/// @brief Takes in an input file and a destination file with option parameters
-/// -b <int> (buffer size), -t (truncate mode), -a (append mode)
-/// @param argc The count of arguments given
-/// @param argv list of arguments delimited by space
-/// @return 0 on success and 1 on error
-int main(int argc, char* argv[])
+// Number of files copied at once in batch mode unless --workers says otherwise
+static const unsigned DEFAULT_WORKERS = 4;
+
+
+/// @brief Validate and convert a count or size given on the command line.
+/// Anything but a plain run of digits, or a value that is 0, is reported on
+/// stderr as "Error: <what> must be ...". Values longer than the type can
+/// always hold are rejected before std::stoll, so it never throws.
+/// @return true if value was set
+static bool parsePositiveInt(const std::string &str, const char *what, long long &value)
 {
-	// Default values
-	int buffSize = 64;
-	bool aMode = false;
-	bool tMode = false;
-	std::string fileIn;
-	std::string fileOut;
-	
-	// Check the number of parameters
-	if (argc < 2)
+	bool digits = !str.empty() && str.size() <= 18;
+	for (auto ch : str)
 	{
-		std::cerr << "Usage: " << argv[0] << " fileIn fileOut" << std::endl;
-		return 0;
+		digits = digits && isdigit(ch);
+	}
+	if (!digits)
+	{
+		std::cerr << "Error: " << what << " must be a positive int. Given: " << str << std::endl;
+		return false;
 	}
+	value = std::stoll(str);
+	if (value <= 0)
+	{
+		std::cerr << "Error: " << what << " must be greater than 0. Given: " << str << std::endl;
+		return false;
+	}
+	return true;
+}
 
-	// Iterate over all cli args (skipping arg[0])
-	// and handle all possible input arguments
-	for (int i = 1; i < argc; i++)
+
+/// @brief int flavour of parsePositiveInt(), which also reports values above INT_MAX
+static bool parsePositiveInt(const std::string &str, const char *what, int &value)
+{
+	long long wide;
+	if (!parsePositiveInt(str, what, wide))
 	{
-		std::string arg = argv[i];
+		return false;
+	}
+	if (wide > INT_MAX)
+	{
+		std::cerr << "Error: " << what << " must be at most " << INT_MAX << ". Given: " << str << std::endl;
+		return false;
+	}
+	value = wide;
+	return true;
+}
+
+
+/// @brief Parse the per-file options and file names into a CopyJob. The command
+/// line and every manifest line go through here, so both accept the same options:
+/// -b <int|auto> (buffer size), -t (truncate mode), -a (append mode),
+/// --engine <auto|copy_file_range|sendfile|splice|uring|parallel|sparse|mmap|direct|nocache|buffer>,
+/// --uring (same as --engine uring), --sparse (same as --engine sparse),
+/// --mmap (same as --engine mmap), --hugepage (MADV_HUGEPAGE for --mmap),
+/// --direct (same as --engine direct), --nocache (same as --engine nocache),
+/// -j <int> (threads for the parallel engine),
+/// --max-buffer <int> (largest buffer -b auto may grow to),
+/// --verify=<crc32c|xxh64> (checksum while copying), --verify-readback (compare with a re-read),
+/// --resume (checkpointed copy that continues after an interruption, -t is ignored
+/// while a matching checkpoint exists),
+/// --checkpoint <int> (bytes between --resume checkpoints)
+/// @param args Arguments delimited by space, without the program name
+/// @param job Filled in on top of whatever it already holds (manifest defaults)
+/// @return 0 on success and 1 on error
+int parseArguments(const std::vector<std::string> &args, CopyJob &job)
+{
+	// Iterate over all args and handle all possible input arguments
+	int argc = args.size();
+	for (int i = 0; i < argc; i++)
+	{
+		std::string arg = args[i];
 		
 		// Handle -b arg
 		if (arg == "-b")
 		{
 			// All "-b" parameters must be followed by additional input
-			// check if the additional input index is out of argv bounds
+			// check if the additional input index is out of bounds
 			if (i + 1 >= argc)		
 			{
 				std::cerr << "Error: Could not find size argument for option -b. " << std::endl << "Usage: fileIn fileOut -b 64" << std::endl;
 				return 1;
 			}
 			// We now have to validate the number provided following -b param
-			std::string buffSizeStr = argv[i + 1];
+			std::string buffSizeStr = args[i + 1];
 
-			for (auto ch : buffSizeStr)
+			// "auto" lets the buffered loop pick its own size at runtime
+			if (buffSizeStr == "auto")
 			{
-				if (!isdigit(ch))	// Check if character is NOT a digit
-				{
-					std::cerr << "Error: Buffer size must be a positive int. Given: " << buffSizeStr << std::endl;
-					return 1;
-				}
+				job.options.autoBuff = true;
+				job.options.buffSizeSet = false;
+				i++;								// Skip "auto"
+				continue;
 			}
 
-			// Convert to integer
-			buffSize = std::stoi(argv[i + 1]);
-
-			// Ensure given buffSize is positive
-			if (buffSize <= 0)
+			int buffSize;
+			if (!parsePositiveInt(buffSizeStr, "Buffer size", buffSize))
 			{
-				std::cerr << "Error: Buffer size must be greater than 0. Given: " << buffSizeStr << std::endl;
 				return 1;
 			}
+			job.options.buffSize = buffSize;
+			job.options.buffSizeSet = true;
+			job.options.autoBuff = false;				// An explicit size wins over an earlier "-b auto"
 			
 			i++;									// Skip the next arg since we just processed it
 		}
+		// Handle --engine arg
+		else if (arg == "--engine")
+		{
+			// Same as -b, the engine name must follow the option
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find name argument for option --engine. " << std::endl << "Usage: fileIn fileOut --engine auto" << std::endl;
+				return 1;
+			}
+			if (!parseEngine(args[i + 1], job.options.engine))
+			{
+				std::cerr << "Error: Unknown engine '" << args[i + 1] << "'. Expected auto, copy_file_range, sendfile, splice, uring, parallel, sparse, mmap, direct, nocache or buffer." << std::endl;
+				return 1;
+			}
+			i++;									// Skip the engine name
+		}
+		// Handle --uring arg
+		else if (arg == "--uring")
+		{
+			job.options.engine = Engine::Uring;
+		}
+		// Handle --sparse arg
+		else if (arg == "--sparse")
+		{
+			job.options.engine = Engine::Sparse;
+		}
+		// Handle --mmap arg
+		else if (arg == "--mmap")
+		{
+			job.options.engine = Engine::Mmap;
+		}
+		// Handle --direct arg
+		else if (arg == "--direct")
+		{
+			job.options.engine = Engine::Direct;
+		}
+		// Handle --nocache arg
+		else if (arg == "--nocache")
+		{
+			job.options.engine = Engine::NoCache;
+		}
+		// Handle --hugepage arg
+		else if (arg == "--hugepage")
+		{
+			job.options.hugePages = true;
+		}
+		// Handle --max-buffer arg
+		else if (arg == "--max-buffer")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find size argument for option --max-buffer. " << std::endl << "Usage: fileIn fileOut -b auto --max-buffer 16777216" << std::endl;
+				return 1;
+			}
+			std::string capStr = args[i + 1];
+			int cap;
+			if (!parsePositiveInt(capStr, "Maximum buffer size", cap))
+			{
+				return 1;
+			}
+			job.options.maxBuffSize = cap;
+			i++;									// Skip the size
+		}
+		// Handle -j arg
+		else if (arg == "-j")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find thread count for option -j. " << std::endl << "Usage: fileIn fileOut -j 4" << std::endl;
+				return 1;
+			}
+			std::string jobsStr = args[i + 1];
+			int jobs;
+			if (!parsePositiveInt(jobsStr, "Thread count", jobs))
+			{
+				return 1;
+			}
+			job.options.jobs = jobs;
+			i++;									// Skip the thread count
+		}
+		// Handle --resume arg
+		else if (arg == "--resume")
+		{
+			job.options.resume = true;
+		}
+		// Handle --checkpoint arg
+		else if (arg == "--checkpoint")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find size argument for option --checkpoint. " << std::endl << "Usage: fileIn fileOut --resume --checkpoint 67108864" << std::endl;
+				return 1;
+			}
+			std::string intervalStr = args[i + 1];
+			long long interval;
+			if (!parsePositiveInt(intervalStr, "Checkpoint interval", interval))
+			{
+				return 1;
+			}
+			job.options.checkpointInterval = interval;
+			i++;									// Skip the interval
+		}
+		// Handle --verify=<name> arg
+		else if (arg.compare(0, 9, "--verify=") == 0)
+		{
+			if (!parseVerify(arg.substr(9), job.options.verify))
+			{
+				std::cerr << "Error: Unknown checksum '" << arg.substr(9) << "'. Expected crc32c or xxh64." << std::endl;
+				return 1;
+			}
+		}
+		// Handle --verify-readback arg
+		else if (arg == "--verify-readback")
+		{
+			job.options.verifyReadback = true;
+		}
 		// Handle -a arg
 		else if (arg == "-a")
 		{
-			aMode = true;
+			job.aMode = true;
 		}
 		// Handle -t arg
 		else if (arg == "-t")
 		{
-			tMode = true;
+			job.tMode = true;
 		}
 		// If its none of the above, it has to be a file name
 		// Handle file name args
 		else 
 		{
 			// We expect to receive fileIn first
-			if (fileIn.empty())
+			if (job.fileIn.empty())
 			{
-				fileIn = arg;
+				job.fileIn = arg;
 			}
 			// If we already saw fileIn, must be fileOut
-			else if (fileOut.empty())
+			else if (job.fileOut.empty())
 			{
-				fileOut = arg;
+				job.fileOut = arg;
 			}
 			// If we have values for fileIn and fileOut, error
 			else
@@ -98,7 +263,23 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	// After loop, we should at least have a fileIn and fileOut
+	return 0;
+}
+
+
+/// @brief Copy one file as described by job: validate it, open both files,
+/// run the copy engines and close everything again
+/// @param used Set to the engine that finished the copy
+/// @return 0 on success, 1 (or -1 if the destination cannot be opened) on error
+int copyFile(const CopyJob &job, Engine &used)
+{
+	CopyOptions options = job.options;
+	const std::string &fileIn = job.fileIn;
+	const std::string &fileOut = job.fileOut;
+	bool aMode = job.aMode;
+	bool tMode = job.tMode;
+
+	// After parsing, we should at least have a fileIn and fileOut
 	// so we check if either of them are empty and throw an error if 
 	// any of the file variables are empty
 	if (fileIn.empty() || fileOut.empty())
@@ -108,6 +289,37 @@ int main(int argc, char* argv[])
 	}
 
 	
+	// Threads only exist in the parallel engine, anything else would ignore -j
+	if (options.jobs > 1 && options.engine != Engine::Auto && options.engine != Engine::Parallel)
+	{
+		std::cerr << "Error: -j can only be combined with --engine parallel (or auto)." << std::endl;
+		return 1;
+	}
+
+	// Checksums are taken while the data passes through user space, in order,
+	// which rules out the kernel-side, io_uring, threaded and sparse engines
+	Engine engine = options.engine;
+	if (options.verify != Verify::None
+		&& (options.jobs > 1 || (engine != Engine::Auto && engine != Engine::Buffer && engine != Engine::Mmap
+								 && engine != Engine::Direct && engine != Engine::NoCache)))
+	{
+		std::cerr << "Error: --verify only works with --engine auto, buffer, mmap, direct or nocache (and no -j)." << std::endl;
+		return 1;
+	}
+	if (options.verifyReadback && options.verify == Verify::None)
+	{
+		std::cerr << "Error: --verify-readback needs --verify=crc32c or --verify=xxh64." << std::endl;
+		return 1;
+	}
+
+	// A resumed copy rewrites the destination from a checkpointed offset, it
+	// has its own engine and cannot hash what an earlier run already copied
+	if (options.resume && (engine != Engine::Auto || options.jobs > 1 || aMode || options.verify != Verify::None))
+	{
+		std::cerr << "Error: --resume cannot be combined with --engine, -j, -a or --verify." << std::endl;
+		return 1;
+	}
+
 	// Handle opening fileIn in read-only mode
 	const char *inPathName = fileIn.c_str();	// open() expects a c_str formated file name
 	int inFlags = O_RDONLY;
@@ -121,13 +333,36 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
+	// --resume only picks up a destination it can vouch for: one with a
+	// checkpoint for this very source next to it. A file at the checkpoint
+	// path that is not one of ours is left alone, and so is the destination.
+	bool resuming = false;
+	if (options.resume)
+	{
+		options.checkpointFile = checkpointPath(fileOut);
+		CheckpointState checkpoint = inspectCheckpoint(options.checkpointFile, inFD);
+		if (checkpoint == CheckpointState::Foreign)
+		{
+			std::cerr << "Error: '" << options.checkpointFile << "' exists but is not a --resume checkpoint. Remove it to copy with --resume." << std::endl;
+			close(inFD);
+			return 1;
+		}
+		resuming = checkpoint == CheckpointState::Matching;
+		if (resuming && tMode)
+		{
+			// The checkpoint vouches for what is already in the destination
+			std::cout << "Resume: matching checkpoint found, -t ignored\n" << std::flush;
+		}
+	}
+
 
 	// Handle opening fileOut with user specified params
 	const char *outPathName = fileOut.c_str();
 
 	// For the destination file, we want to only allow
-	// calling this program on existing files if -t or -a are given.
-	if (access(outPathName, F_OK) == 0)		// If destination file exists
+	// calling this program on existing files if -t or -a are given,
+	// or if it is a --resume destination with a matching checkpoint next to it.
+	if (access(outPathName, F_OK) == 0 && !resuming)		// If destination file exists
 	{
 		if (!aMode && !tMode)
 		{
@@ -138,8 +373,12 @@ int main(int argc, char* argv[])
 	}
 
 	int outFlags = O_WRONLY | O_CREAT;			// Open for write, create if doesn't exit
+	if (options.engine == Engine::Mmap || options.resume)
+	{
+		outFlags = O_RDWR | O_CREAT;			// A shared writable mapping (or --resume's check) needs read access too
+	}
 	// Add more flags based on options selected by given params
-	if (tMode)									// Check for "-t"
+	if (tMode && !resuming)						// Check for "-t"
 	{
 		outFlags |= O_TRUNC;					// Truncate file
 	}
@@ -152,6 +391,7 @@ int main(int argc, char* argv[])
 	if (tMode && aMode)
 	{
 		std::cerr << "ERROR: Both -a and -t were given." << std::endl;
+		close(inFD);
 		return 1;
 	}
 	
@@ -163,40 +403,47 @@ int main(int argc, char* argv[])
 	if (outFD == -1)
 	{
 		std::cerr << "Error opening source file." << std::endl;
+		close(inFD);
 		return -1;
 	}
 
 
-	// Now we handle reading and writing to the opened files
-	std::vector<char> buffer(buffSize);
-
-	ssize_t readBytes;
-	while ((readBytes = read(inFD, buffer.data(), buffSize)) > 0)
+	// The kernel-side engines refuse O_APPEND destinations, and positioned
+	// writes (-j, --uring) would be redirected to the end of file by it, so
+	// for -a we fix the append position once and let them write from there
+	if (aMode && options.engine != Engine::Buffer && pinAppendOffset(outFD) == -1)
 	{
-		// Write read bytes to outFD
-		ssize_t writtenBytes = write(outFD, buffer.data(), readBytes);
-
-		// Ensure bytes written are equavalent to bytes read
-		// If we find that they are not, we return error and close the files
-		if (writtenBytes != readBytes)
-		{
-			std::cerr << "Error writing to destination file." << std::endl;
-			close(inFD);
-			close(outFD);
-			return 1;
-		}
+		std::cerr << "Error seeking to the end of destination file." << std::endl;
+		close(inFD);
+		close(outFD);
+		return 1;
 	}
 
-	// Now we can check the values of readBytes
-	// where we expect a positive value (error returns -1)
-	if (readBytes == -1)
+	// Now we handle copying between the opened files, starting with the
+	// requested engine and falling back to the buffered loop if refused
+	// The copied data lands after whatever is already there (-a), which is
+	// where a read back has to start
+	Checksum checksum(options.verify);
+	Checksum *feed = options.verify != Verify::None ? &checksum : nullptr;
+	struct stat outStat;
+	off_t outStart = fstat(outFD, &outStat) == 0 ? outStat.st_size : 0;
+
+	CopyStatus status;
+	used = runCopy(options, inFD, outFD, status, feed);
+	if (status != CopyStatus::Done)
 	{
-		std::cerr << "Error reading from source file." << std::endl;
 		close(inFD);
 		close(outFD);
 		return 1;
 	}
 
+	// The engines leave the source offset after the copied data
+	off_t copiedBytes = lseek(inFD, 0, SEEK_CUR);
+	if (statsEnabled() && copiedBytes != -1)
+	{
+		recordFile(copiedBytes);
+	}
+
 	// If no error until now, we can close the files and again
 	// ensure the close() exacutes without any issues
 	if (close(inFD) == -1)
@@ -210,11 +457,174 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
+	if (feed)
+	{
+		// One write per line, batch workers may be reporting at the same time
+		std::string line = std::string("Checksum (") + verifyName(options.verify) + "): "
+						   + checksum.digest() + " (" + fileIn + " -> " + fileOut + ")\n";
+		std::cout << line << std::flush;
+	}
+
+	// Read the destination back, from the device where O_DIRECT allows, and
+	// make sure it hashes to the same value as the data we sent
+	if (options.verifyReadback)
+	{
+		Checksum readback(options.verify);
+		bool direct;
+		if (!checksumFile(fileOut, outStart, copiedBytes, readback, direct))
+		{
+			return 1;
+		}
+		if (readback.digest() != checksum.digest())
+		{
+			std::cerr << "Error: Checksum mismatch for '" << fileOut << "' (copied " << checksum.digest()
+					  << ", read back " << readback.digest() << ")." << std::endl;
+			return 1;
+		}
+		std::string line = std::string("Verified: ") + fileOut + " matches"
+						   + (direct ? " (O_DIRECT read back)" : " (read back through the page cache)") + "\n";
+		std::cout << line << std::flush;
+	}
+
 	// Hurray! Files were opened, read, written, and close with sucess!
-	std::cout << "Operations successful!" << std::endl;
 	return 0;
 }
 
+/// @brief Takes in an input file and a destination file with option parameters
+/// (see parseArguments), or one of the batch modes:
+/// --manifest <file> (one "fileIn fileOut [options]" per line),
+/// -r <srcDir> <destDir> (copy a directory tree),
+/// --workers <int> (files copied concurrently in batch mode),
+/// --stats[=human|json] (byte, time and syscall report on stderr)
+/// @param argc The count of arguments given
+/// @param argv list of arguments delimited by space
+/// @return 0 on success and 1 on error
+int main(int argc, char* argv[])
+{
+	// Check the number of parameters
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " fileIn fileOut" << std::endl;
+		return 0;
+	}
+
+	// Batch options are taken out first, everything else is the per-file
+	// config (and, for a manifest, the defaults for every line)
+	std::vector<std::string> args;
+	std::string manifest;
+	bool recursive = false;
+	unsigned workers = DEFAULT_WORKERS;
+	bool stats = false;
+	StatFormat statFormat = StatFormat::Human;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--manifest")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find file argument for option --manifest. " << std::endl << "Usage: --manifest jobs.txt" << std::endl;
+				return 1;
+			}
+			manifest = argv[++i];
+		}
+		else if (arg == "-r")
+		{
+			recursive = true;
+		}
+		else if (arg == "--workers")
+		{
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Error: Could not find count argument for option --workers. " << std::endl << "Usage: --workers 4" << std::endl;
+				return 1;
+			}
+			std::string workersStr = argv[++i];
+			int count;
+			if (!parsePositiveInt(workersStr, "Worker count", count))
+			{
+				return 1;
+			}
+			workers = count;
+		}
+		else if (arg == "--stats" || arg == "--stats=human" || arg == "--stats=json")
+		{
+			stats = true;
+			statFormat = arg == "--stats=json" ? StatFormat::Json : StatFormat::Human;
+		}
+		else if (arg.compare(0, 8, "--stats=") == 0)
+		{
+			std::cerr << "Error: Unknown stats format '" << arg.substr(8) << "'. Expected human or json." << std::endl;
+			return 1;
+		}
+		else
+		{
+			args.push_back(arg);
+		}
+	}
+
+	CopyJob job;
+	if (parseArguments(args, job) != 0)
+	{
+		return 1;
+	}
+
+	if (stats)
+	{
+		enableStats();
+	}
+
+	// Single file: the original behaviour
+	if (manifest.empty() && !recursive)
+	{
+		Engine used;
+		int result = copyFile(job, used);
+		if (result == 0)
+		{
+			std::cout << "Engine used: " << engineName(used) << std::endl;
+			std::cout << "Operations successful!" << std::endl;
+		}
+		if (stats)
+		{
+			printStats(statFormat);
+		}
+		return result;
+	}
+
+	std::vector<CopyJob> jobs;
+	unsigned invalid = 0;
+	if (!manifest.empty())
+	{
+		if (recursive || !job.fileIn.empty())
+		{
+			std::cerr << "Error: --manifest takes its file names from the manifest." << std::endl;
+			return 1;
+		}
+		if (!loadManifest(manifest, job, jobs, invalid))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		if (job.fileIn.empty() || job.fileOut.empty())
+		{
+			std::cerr << "Error: -r needs a source and a destination directory." << std::endl;
+			return 1;
+		}
+		if (!scanTree(job, jobs))
+		{
+			return 1;
+		}
+	}
+	int result = runBatch(jobs, workers, invalid);
+	if (stats)
+	{
+		printStats(statFormat);
+	}
+	return result;
+}
+
 
 /*
 Works Cited:
@@ -230,6 +640,11 @@ Reading about open(), close(), read(), write() system calls
 - https://www.geeksforgeeks.org/system-call-in-c/#
 - https://man7.org/linux/man-pages/man2/open.2.html
 
+Reading about kernel-side copies:
+- https://man7.org/linux/man-pages/man2/copy_file_range.2.html
+- https://man7.org/linux/man-pages/man2/sendfile.2.html
+- https://man7.org/linux/man-pages/man2/splice.2.html
+
 Reading about stoi validation:
 - https://cplusplus.com/reference/string/stoi/
 
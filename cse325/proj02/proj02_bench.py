@@ -0,0 +1,175 @@
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+
+# Every --engine proj02 accepts. The ones in BUFFERED_ENGINES move data in
+# -b sized requests and are run once per buffer size, the others ignore -b
+# and are run once per file.
+ENGINES = ["auto", "copy_file_range", "sendfile", "splice", "uring", "parallel",
+           "sparse", "mmap", "direct", "nocache", "buffer"]
+BUFFERED_ENGINES = {"uring", "parallel", "direct", "nocache", "buffer"}
+
+DEFAULT_SIZES = "1K,64K,1M,16M,256M,1G,10G"
+DEFAULT_BUFFERS = "4K,64K,1M,8M"
+
+# Sparse files get one data extent of this size every SPARSE_STRIDE bytes
+SPARSE_EXTENT = 1 << 20
+SPARSE_STRIDE = 64 << 20
+
+# Dense files are written from one random block repeated, generating 10 GB
+# of fresh random data would take longer than copying it
+FILL_BLOCK = 16 << 20
+
+CSV_FIELDS = ["size_bytes", "layout", "engine", "engine_used", "buffer_bytes", "jobs", "cache",
+              "status", "wall_s", "mb_per_s", "cpu_user_s", "cpu_sys_s",
+              "read_calls", "write_calls", "copy_calls", "sync_calls"]
+
+
+def parse_size(text):
+    units = {"K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+    text = text.strip().upper()
+    if text and text[-1] in units:
+        return int(text[:-1]) * units[text[-1]]
+    return int(text)
+
+
+def create_source(path, size, layout):
+    """Write a dense or sparse test file of exactly size bytes."""
+    with open(path, "wb") as f:
+        if layout == "dense":
+            block = os.urandom(min(size, FILL_BLOCK))
+            written = 0
+            while written < size:
+                chunk = block[:size - written]
+                f.write(chunk)
+                written += len(chunk)
+        else:
+            f.truncate(size)
+            for offset in range(0, size, SPARSE_STRIDE):
+                f.seek(offset)
+                f.write(os.urandom(min(SPARSE_EXTENT, size - offset)))
+    # Make sure generating the file does not leave dirty pages behind
+    # to be written back in the middle of a timed run
+    os.sync()
+
+
+def drop_caches(source):
+    """Start a run with a cold source. Dropping the whole page cache needs root;
+    without it, ask the kernel to evict just the source file, which works for
+    any file we can open since its pages are clean after os.sync()."""
+    os.sync()
+    try:
+        with open("/proc/sys/vm/drop_caches", "w") as f:
+            f.write("3\n")
+        return "drop_caches"
+    except OSError:
+        fd = os.open(source, os.O_RDONLY)
+        try:
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+        return "fadvise"
+
+
+def run_copy(program, source, dest, engine, buffer_size, jobs, warm):
+    """Run proj02 once with --stats=json and return one CSV row."""
+    if os.path.exists(dest):
+        os.remove(dest)
+    cache = "warm" if warm else drop_caches(source)
+
+    cmd = [program, source, dest, "--engine", engine, "--stats=json"]
+    if buffer_size:
+        cmd += ["-b", str(buffer_size)]
+    if engine == "parallel":
+        cmd += ["-j", str(jobs)]
+    result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+
+    row = {"size_bytes": os.path.getsize(source), "engine": engine,
+           "buffer_bytes": buffer_size or "", "jobs": jobs if engine == "parallel" else 1,
+           "cache": cache, "status": "ok" if result.returncode == 0 else "failed"}
+    for line in result.stdout.splitlines():
+        if line.startswith("Engine used: "):
+            row["engine_used"] = line[len("Engine used: "):]
+
+    # The stats report is the only JSON line on stderr
+    stats = None
+    for line in result.stderr.splitlines():
+        if line.startswith("{"):
+            stats = json.loads(line)
+    if stats is not None:
+        calls = stats["calls"]
+        row.update({"wall_s": stats["wall_s"], "mb_per_s": round(stats["mb_per_s"], 1),
+                    "cpu_user_s": stats["cpu_user_s"], "cpu_sys_s": stats["cpu_sys_s"],
+                    "read_calls": calls["read"]["count"], "write_calls": calls["write"]["count"],
+                    "copy_calls": calls["copy"]["count"], "sync_calls": calls["sync"]["count"]})
+    if row["status"] == "ok" and os.path.getsize(dest) != row["size_bytes"]:
+        row["status"] = "size mismatch"
+    if row["status"] != "ok":
+        print(f"  {engine} failed: {result.stderr.strip()}", file=sys.stderr)
+    if os.path.exists(dest):
+        os.remove(dest)
+    return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark every proj02 copy engine over file and buffer sizes.")
+    parser.add_argument("--program", default="./proj02", help="proj02 binary (default ./proj02)")
+    parser.add_argument("--dir", default="bench_data", help="scratch directory for the test files")
+    parser.add_argument("--csv", default="bench.csv", help="CSV file to write (default bench.csv)")
+    parser.add_argument("--sizes", default=DEFAULT_SIZES, help=f"file sizes (default {DEFAULT_SIZES})")
+    parser.add_argument("--max-size", default=None, help="skip sizes above this, e.g. 1G")
+    parser.add_argument("--buffers", default=DEFAULT_BUFFERS, help=f"-b sweep (default {DEFAULT_BUFFERS})")
+    parser.add_argument("--engines", default=",".join(ENGINES), help="engines to run (default all)")
+    parser.add_argument("--layouts", default="dense,sparse", help="dense, sparse or both")
+    parser.add_argument("--jobs", type=int, default=4, help="-j for the parallel engine (default 4)")
+    parser.add_argument("--repeat", type=int, default=1, help="runs per combination (default 1)")
+    parser.add_argument("--warm", action="store_true", help="keep the page cache between runs")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.program):
+        print(f"Error: '{args.program}' not found, run make first.")
+        sys.exit(1)
+    sizes = [parse_size(s) for s in args.sizes.split(",")]
+    if args.max_size:
+        sizes = [s for s in sizes if s <= parse_size(args.max_size)]
+    buffers = [parse_size(b) for b in args.buffers.split(",")]
+    engines = args.engines.split(",")
+    for engine in engines:
+        if engine not in ENGINES:
+            print(f"Error: Unknown engine '{engine}'.")
+            sys.exit(1)
+
+    os.makedirs(args.dir, exist_ok=True)
+    source = os.path.join(args.dir, "bench_source")
+    dest = os.path.join(args.dir, "bench_dest")
+    rows = 0
+    with open(args.csv, "w", newline="") as out:
+        writer = csv.DictWriter(out, fieldnames=CSV_FIELDS)
+        writer.writeheader()
+        for size in sizes:
+            for layout in args.layouts.split(","):
+                print(f"Creating {layout} source of {size} bytes...")
+                create_source(source, size, layout)
+                for engine in engines:
+                    sweep = buffers if engine in BUFFERED_ENGINES else [None]
+                    for buffer_size in sweep:
+                        for _ in range(args.repeat):
+                            row = run_copy(args.program, source, dest, engine, buffer_size,
+                                           args.jobs, args.warm)
+                            row["layout"] = layout
+                            writer.writerow(row)
+                            out.flush()
+                            rows += 1
+                            print(f"  {engine:<16} -b {str(buffer_size or '-'):>8}  "
+                                  f"{row.get('mb_per_s', '-'):>8} MB/s  {row['status']}")
+                os.remove(source)
+    if not os.listdir(args.dir):
+        os.rmdir(args.dir)
+    print(f"\n{rows} runs written to {args.csv}")
+
+
+if __name__ == "__main__":
+    main()
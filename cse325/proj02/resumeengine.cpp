@@ -0,0 +1,277 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <vector>			// for the copy buffer
+#include <algorithm>		// for std::min
+#include <cstdio>			// for snprintf(), sscanf()
+#include <cstring>			// for strlen()
+#include <cerrno>			// for errno
+#include <unistd.h>			// for pread(), pwrite(), fdatasync(), ftruncate(), unlink()
+#include <fcntl.h>			// for open()
+#include <sys/stat.h>		// for fstat()
+
+
+// Bytes at the end of the last checkpointed chunk compared between source and
+// destination before a copy is resumed. Read from the page cache right after
+// the chunk is copied, so it costs little next to the fdatasync().
+static const off_t TAIL_CHECK = 1 << 20;
+
+// The checkpoint is one fixed-size text record, rewritten in place. It is far
+// smaller than a sector, so it is never torn, and it carries its own CRC anyway.
+static const size_t RECORD_SIZE = 160;
+
+
+/// @brief Contents of the checkpoint file
+struct Checkpoint
+{
+	long long size = 0;				// Source size and modification time, so a
+	long long mtimeSec = 0;			// checkpoint is never applied to a different source
+	long long mtimeNsec = 0;
+	long long done = 0;				// Bytes durable in the destination
+	long long tailLength = 0;		// Bytes covered by tailDigest, ending at done
+	std::string tailDigest = "-";	// CRC-32C of those bytes
+};
+
+
+std::string checkpointPath(const std::string &fileOut)
+{
+	return fileOut + ".resume";
+}
+
+
+/// @brief Render a checkpoint as its fixed-size record
+static std::string formatCheckpoint(const Checkpoint &checkpoint)
+{
+	char text[RECORD_SIZE];
+	snprintf(text, sizeof(text), "proj02-resume 1 %lld %lld %lld %lld %lld %s",
+			 checkpoint.size, checkpoint.mtimeSec, checkpoint.mtimeNsec, checkpoint.done,
+			 checkpoint.tailLength, checkpoint.tailDigest.c_str());
+	Checksum crc(Verify::Crc32c);
+	crc.update(text, strlen(text));
+
+	std::string record = std::string(text) + " " + crc.digest();
+	record.resize(RECORD_SIZE - 1, ' ');
+	return record + "\n";
+}
+
+
+/// @brief Parse a record written by formatCheckpoint(), false if it is not one
+static bool parseCheckpoint(const std::string &record, Checkpoint &checkpoint)
+{
+	size_t crcStart = record.find_last_of(' ', record.find_last_not_of(" \n"));
+	if (crcStart == std::string::npos)
+	{
+		return false;
+	}
+	Checksum crc(Verify::Crc32c);
+	crc.update(record.data(), crcStart);
+	if (record.compare(crcStart + 1, 8, crc.digest()) != 0)
+	{
+		return false;
+	}
+
+	char digest[17];
+	int version;
+	if (sscanf(record.c_str(), "proj02-resume %d %lld %lld %lld %lld %lld %16s", &version, &checkpoint.size,
+			   &checkpoint.mtimeSec, &checkpoint.mtimeNsec, &checkpoint.done, &checkpoint.tailLength,
+			   digest) != 7 || version != 1)
+	{
+		return false;
+	}
+	checkpoint.tailDigest = digest;
+	return true;
+}
+
+
+/// @brief The checkpoint fields that describe the source open as fd
+static bool describeSource(int fd, Checkpoint &checkpoint)
+{
+	struct stat inStat;
+	if (fstat(fd, &inStat) == -1 || !S_ISREG(inStat.st_mode))
+	{
+		return false;
+	}
+	checkpoint.size = inStat.st_size;
+	checkpoint.mtimeSec = inStat.st_mtim.tv_sec;
+	checkpoint.mtimeNsec = inStat.st_mtim.tv_nsec;
+	return true;
+}
+
+
+/// @brief Whether saved was taken of the source that current describes
+static bool sameSource(const Checkpoint &saved, const Checkpoint &current)
+{
+	return saved.size == current.size && saved.mtimeSec == current.mtimeSec
+		   && saved.mtimeNsec == current.mtimeNsec && saved.done <= current.size;
+}
+
+
+/// @brief Read the record at the start of the checkpoint file open as fd
+static bool readCheckpoint(int fd, Checkpoint &checkpoint)
+{
+	std::string record(RECORD_SIZE, '\0');
+	ssize_t recordBytes = pread(fd, &record[0], RECORD_SIZE, 0);
+	if (recordBytes <= 0)
+	{
+		return false;
+	}
+	record.resize(recordBytes);
+	return parseCheckpoint(record, checkpoint);
+}
+
+
+CheckpointState inspectCheckpoint(const std::string &checkpointPath, int inFD)
+{
+	int checkpointFD = open(checkpointPath.c_str(), O_RDONLY);
+	if (checkpointFD == -1)
+	{
+		return errno == ENOENT ? CheckpointState::None : CheckpointState::Foreign;
+	}
+	Checkpoint saved;
+	bool parsed = readCheckpoint(checkpointFD, saved);
+	close(checkpointFD);
+	if (!parsed)
+	{
+		return CheckpointState::Foreign;
+	}
+	Checkpoint current;
+	return describeSource(inFD, current) && sameSource(saved, current) ? CheckpointState::Matching
+																	   : CheckpointState::Stale;
+}
+
+
+/// @brief CRC-32C of the length bytes of fd that end at end
+static bool tailDigest(int fd, off_t end, off_t length, std::vector<char> &buffer, std::string &digest)
+{
+	Checksum crc(Verify::Crc32c);
+	for (off_t position = end - length; position < end; )
+	{
+		ssize_t readBytes = timedPread(fd, buffer.data(), std::min((off_t)buffer.size(), end - position), position);
+		if (readBytes <= 0)
+		{
+			return false;
+		}
+		crc.update(buffer.data(), readBytes);
+		position += readBytes;
+	}
+	digest = crc.digest();
+	return true;
+}
+
+
+/// @brief Overwrite the checkpoint record and make it durable
+static bool writeCheckpoint(int fd, const Checkpoint &checkpoint)
+{
+	std::string record = formatCheckpoint(checkpoint);
+	return pwrite(fd, record.data(), record.size(), 0) == (ssize_t)record.size()
+		   && timedCall(StatCall::Sync, [&] { return (ssize_t)fdatasync(fd); }) == 0;
+}
+
+
+CopyStatus copyResumable(int inFD, int outFD, const std::string &checkpointPath,
+						 off_t checkpointInterval, size_t buffSize, Engine &used)
+{
+	used = Engine::CopyFileRange;
+	Checkpoint current;
+	if (!describeSource(inFD, current))
+	{
+		std::cerr << "Error: --resume needs a regular source file." << std::endl;
+		return CopyStatus::Failed;
+	}
+
+	int checkpointFD = open(checkpointPath.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (checkpointFD == -1)
+	{
+		std::cerr << "Error opening checkpoint file '" << checkpointPath << "'." << std::endl;
+		return CopyStatus::Failed;
+	}
+	std::vector<char> buffer(std::max(buffSize, (size_t)65536));
+
+	// Pick up where the last run left off, but only if the checkpoint belongs
+	// to this source and the last chunk it vouches for really is in both files.
+	// The caller has made sure an existing file here is one of our checkpoints.
+	Checkpoint saved;
+	if (readCheckpoint(checkpointFD, saved))
+	{
+		std::string sourceTail;
+		std::string destinationTail;
+		if (!sameSource(saved, current))
+		{
+			std::cout << "Resume: checkpoint does not belong to this source, starting over." << std::endl;
+		}
+		else if (saved.done > 0
+				 && (!tailDigest(inFD, saved.done, saved.tailLength, buffer, sourceTail)
+					 || !tailDigest(outFD, saved.done, saved.tailLength, buffer, destinationTail)
+					 || sourceTail != saved.tailDigest || destinationTail != saved.tailDigest))
+		{
+			std::cout << "Resume: last checkpointed chunk does not match, starting over." << std::endl;
+		}
+		else
+		{
+			current = saved;
+			std::cout << "Resume: continuing at " << current.done << " of " << current.size << " bytes" << std::endl;
+		}
+	}
+
+	if (current.done == 0)
+	{
+		// Nothing trusted in the destination. Record that it is ours before
+		// writing to it, so an interruption from here on can still be resumed.
+		if (ftruncate(outFD, 0) == -1 || !writeCheckpoint(checkpointFD, current))
+		{
+			std::cerr << "Error starting checkpoint file '" << checkpointPath << "'." << std::endl;
+			close(checkpointFD);
+			return CopyStatus::Failed;
+		}
+	}
+
+	bool useKernel = true;
+	std::vector<char> copyBuffer;
+	while (current.done < current.size)
+	{
+		off_t length = std::min((off_t)checkpointInterval, (off_t)(current.size - current.done));
+		if (!copyExtent(inFD, outFD, current.done, current.done, length, copyBuffer, buffSize, useKernel))
+		{
+			close(checkpointFD);
+			return CopyStatus::Failed;
+		}
+		current.done += length;
+
+		// Checkpoint: the data has to be durable before the record that points past it
+		current.tailLength = std::min(length, TAIL_CHECK);
+		if (!tailDigest(inFD, current.done, current.tailLength, buffer, current.tailDigest)
+			|| timedCall(StatCall::Sync, [&] { return (ssize_t)fdatasync(outFD); }) == -1
+			|| !writeCheckpoint(checkpointFD, current))
+		{
+			std::cerr << "Error writing checkpoint." << std::endl;
+			close(checkpointFD);
+			return CopyStatus::Failed;
+		}
+		if (statsEnabled())
+		{
+			recordCheckpoint(checkpointInterval);
+		}
+	}
+	if (!useKernel)
+	{
+		used = Engine::Buffer;
+	}
+
+	// Make sure the destination ends exactly where the source does (an empty
+	// source never went through the loop)
+	struct stat outStat;
+	if (fstat(outFD, &outStat) == -1 || (outStat.st_size != current.size && ftruncate(outFD, current.size) == -1))
+	{
+		std::cerr << "Error resizing destination file." << std::endl;
+		close(checkpointFD);
+		return CopyStatus::Failed;
+	}
+
+	// Done: the checkpoint has served its purpose
+	close(checkpointFD);
+	unlink(checkpointPath.c_str());
+
+	seekPastCopy(inFD, outFD, current.size, current.size);
+	return CopyStatus::Done;
+}
@@ -0,0 +1,140 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <string>			// for std::to_string
+#include <vector>			// for the fallback buffer
+#include <algorithm>		// for std::min
+#include <cerrno>			// for ENXIO and refusal checks
+#include <unistd.h>			// for lseek(), pread(), pwrite(), ftruncate()
+#include <sys/stat.h>		// for fstat()
+
+
+bool copyExtent(int inFD, int outFD, off_t inOffset, off_t outOffset, off_t length,
+				std::vector<char> &buffer, size_t buffSize, bool &useKernel)
+{
+	while (length > 0 && useKernel)
+	{
+		ssize_t copied = timedCall(StatCall::Copy, [&] { return copy_file_range(inFD, &inOffset, outFD, &outOffset, length, 0); });
+		if (copied > 0)
+		{
+			length -= copied;
+			continue;
+		}
+		if (copied == -1 && !isRefusal(errno))
+		{
+			std::cerr << "Error copying with copy_file_range." << std::endl;
+			return false;
+		}
+		useKernel = false;		// Refused (or returned 0 early), finish with plain I/O
+	}
+
+	if (length > 0 && buffer.empty())
+	{
+		buffer.resize(buffSize);
+	}
+	while (length > 0)
+	{
+		ssize_t readBytes = timedPread(inFD, buffer.data(), std::min((off_t)buffSize, length), inOffset);
+		if (readBytes <= 0)
+		{
+			std::cerr << "Error reading from source file." << std::endl;
+			return false;
+		}
+		// Same short-write rule as the buffered loop
+		ssize_t writtenBytes = timedPwrite(outFD, buffer.data(), readBytes, outOffset);
+		if (writtenBytes != readBytes)
+		{
+			std::cerr << "Error writing to destination file." << std::endl;
+			return false;
+		}
+		inOffset += readBytes;
+		outOffset += readBytes;
+		length -= readBytes;
+	}
+	return true;
+}
+
+
+CopyStatus copySparse(int inFD, int outFD, size_t buffSize)
+{
+	struct stat inStat;
+	if (fstat(inFD, &inStat) == -1 || !S_ISREG(inStat.st_mode))
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t end = inStat.st_size;
+
+	std::vector<char> buffer;
+	bool useKernel = true;
+	off_t transferred = 0;
+	unsigned extents = 0;
+
+	// Walk data extents: SEEK_DATA finds the next byte that is backed by
+	// storage, SEEK_HOLE finds where that run of data stops. Filesystems
+	// without hole tracking report the whole file as one extent.
+	off_t position = inBase;
+	while (position < end)
+	{
+		off_t data = lseek(inFD, position, SEEK_DATA);
+		if (data == -1)
+		{
+			if (errno == ENXIO)
+			{
+				break;						// Only a hole left until EOF
+			}
+			if (errno == EINVAL && extents == 0)
+			{
+				lseek(inFD, inBase, SEEK_SET);
+				return CopyStatus::Unsupported;
+			}
+			std::cerr << "Error finding data in source file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		off_t hole = lseek(inFD, data, SEEK_HOLE);
+		if (hole == -1)
+		{
+			std::cerr << "Error finding holes in source file." << std::endl;
+			return CopyStatus::Failed;
+		}
+		hole = std::min(hole, end);
+
+		// Holes are skipped, not written: the destination region is always new
+		// (fresh file, -t truncated, or past the old end for -a), so anything
+		// we do not write stays a hole there too
+		if (!copyExtent(inFD, outFD, data, outBase + (data - inBase), hole - data,
+						buffer, buffSize, useKernel))
+		{
+			return CopyStatus::Failed;
+		}
+		transferred += hole - data;
+		extents++;
+		position = hole;
+	}
+
+	// A trailing hole has no data to write, so give the destination its
+	// full logical length explicitly
+	off_t logical = end > inBase ? end - inBase : 0;
+	struct stat outStat;
+	if (fstat(outFD, &outStat) == -1
+		|| (outStat.st_size < outBase + logical && ftruncate(outFD, outBase + logical) == -1))
+	{
+		std::cerr << "Error resizing destination file." << std::endl;
+		return CopyStatus::Failed;
+	}
+
+	seekPastCopy(inFD, outFD, inBase + logical, outBase + logical);
+
+	// One write, batch workers may be reporting at the same time
+	std::string line = "Sparse copy: " + std::to_string(transferred) + " of " + std::to_string(logical)
+					   + " bytes transferred (" + std::to_string(extents) + " data extent"
+					   + (extents == 1 ? "" : "s") + ")\n";
+	std::cout << line << std::flush;
+	return CopyStatus::Done;
+}
@@ -0,0 +1,454 @@
+#include "copyengine.h"
+#include "copystats.h"
+
+#include <iostream>
+#include <vector>			// for slot bookkeeping
+#include <algorithm>		// for std::min
+#include <cerrno>			// for errno / -ECANCELED
+#include <cstdlib>			// for posix_memalign(), free()
+#include <cstring>			// for memset()
+#include <unistd.h>			// for syscall(), lseek(), close()
+#include <sys/mman.h>		// for mapping the ring
+#include <sys/stat.h>		// for fstat()
+#include <sys/syscall.h>	// for __NR_io_uring_*
+#include <sys/uio.h>		// for struct iovec
+#include <linux/io_uring.h>	// for the ring ABI (no liburing dependency)
+
+
+// Number of buffers (and therefore chunks) kept in flight. Each one owns a
+// read->write pair, so the ring itself needs twice as many entries.
+static const unsigned URING_DEPTH = 8;
+
+
+/// @brief Minimal io_uring wrapper: the mapped submission/completion rings
+/// and the bookkeeping needed to push SQEs and reap CQEs without liburing.
+struct Ring
+{
+	int fd = -1;
+
+	// Submission queue
+	unsigned *sqHead = nullptr;
+	unsigned *sqTail = nullptr;
+	unsigned *sqMask = nullptr;
+	unsigned *sqArray = nullptr;
+	unsigned sqEntries = 0;
+	io_uring_sqe *sqes = nullptr;
+	unsigned unpublished = 0;		// SQEs filled in past the shared tail
+	unsigned toSubmit = 0;
+
+	// Completion queue
+	unsigned *cqHead = nullptr;
+	unsigned *cqTail = nullptr;
+	unsigned *cqMask = nullptr;
+	io_uring_cqe *cqes = nullptr;
+
+	// Mappings, kept for munmap()
+	void *sqPtr = MAP_FAILED;
+	size_t sqLen = 0;
+	void *cqPtr = MAP_FAILED;
+	size_t cqLen = 0;
+	size_t sqesLen = 0;
+};
+
+
+/// @brief Per-buffer state of one chunk as it moves through the ring
+struct Slot
+{
+	off_t offset = 0;		// Chunk offset relative to the start of the copy
+	size_t length = 0;		// Bytes this chunk should carry
+	size_t readBytes = 0;	// Bytes of the chunk currently in the buffer
+	size_t written = 0;		// Bytes of the chunk already at the destination
+	bool eof = false;		// Source ended inside this chunk
+	unsigned inFlight = 0;	// SQEs submitted and not yet completed
+	bool active = false;	// Slot holds a chunk that is not finished yet
+	uint64_t queuedAt = 0;	// statStart() when its SQEs were queued, for --stats
+};
+
+
+static bool setupRing(Ring &ring, unsigned entries)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring.fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring.fd == -1)
+	{
+		return false;
+	}
+
+	ring.sqLen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring.cqLen = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMap && ring.cqLen > ring.sqLen)
+	{
+		ring.sqLen = ring.cqLen;
+	}
+
+	ring.sqPtr = mmap(NULL, ring.sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  ring.fd, IORING_OFF_SQ_RING);
+	if (ring.sqPtr == MAP_FAILED)
+	{
+		return false;
+	}
+	if (singleMap)
+	{
+		ring.cqPtr = ring.sqPtr;
+	}
+	else
+	{
+		ring.cqPtr = mmap(NULL, ring.cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						  ring.fd, IORING_OFF_CQ_RING);
+		if (ring.cqPtr == MAP_FAILED)
+		{
+			return false;
+		}
+	}
+
+	ring.sqesLen = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqesPtr = mmap(NULL, ring.sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						 ring.fd, IORING_OFF_SQES);
+	if (sqesPtr == MAP_FAILED)
+	{
+		return false;
+	}
+	ring.sqes = (io_uring_sqe *)sqesPtr;
+
+	char *sq = (char *)ring.sqPtr;
+	ring.sqHead = (unsigned *)(sq + params.sq_off.head);
+	ring.sqTail = (unsigned *)(sq + params.sq_off.tail);
+	ring.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+	ring.sqArray = (unsigned *)(sq + params.sq_off.array);
+	ring.sqEntries = params.sq_entries;
+
+	char *cq = (char *)ring.cqPtr;
+	ring.cqHead = (unsigned *)(cq + params.cq_off.head);
+	ring.cqTail = (unsigned *)(cq + params.cq_off.tail);
+	ring.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+	ring.cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+	return true;
+}
+
+
+static void teardownRing(Ring &ring)
+{
+	if (ring.sqes)
+	{
+		munmap(ring.sqes, ring.sqesLen);
+	}
+	if (ring.cqPtr != MAP_FAILED && ring.cqPtr != ring.sqPtr)
+	{
+		munmap(ring.cqPtr, ring.cqLen);
+	}
+	if (ring.sqPtr != MAP_FAILED)
+	{
+		munmap(ring.sqPtr, ring.sqLen);
+	}
+	if (ring.fd != -1)
+	{
+		close(ring.fd);
+	}
+}
+
+
+/// @brief Claim the next free SQE. The ring is sized for every slot to have
+/// a read and a write queued at once, so this never runs out. The kernel
+/// does not see it until publishSqes() moves the shared tail past it.
+static io_uring_sqe *nextSqe(Ring &ring)
+{
+	unsigned index = (*ring.sqTail + ring.unpublished) & *ring.sqMask;
+	io_uring_sqe *sqe = &ring.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+
+	ring.sqArray[index] = index;
+	ring.unpublished++;
+	ring.toSubmit++;
+	return sqe;
+}
+
+
+/// @brief Hand every claimed SQE to the kernel. Called just before
+/// io_uring_enter, once the callers have filled them in completely (the link
+/// flag on a read is set after queueIO returns), so the release store on
+/// the tail covers every field.
+static void publishSqes(Ring &ring)
+{
+	if (ring.unpublished > 0)
+	{
+		__atomic_store_n(ring.sqTail, *ring.sqTail + ring.unpublished, __ATOMIC_RELEASE);
+		ring.unpublished = 0;
+	}
+}
+
+
+/// @brief Queue a read or write of [slot.offset + done, slot.offset + done + length)
+static io_uring_sqe *queueIO(Ring &ring, bool isWrite, bool fixed, int fd, char *buffer,
+							 unsigned slotIndex, size_t done, size_t length, off_t fileOffset)
+{
+	io_uring_sqe *sqe = nextSqe(ring);
+	if (fixed)
+	{
+		sqe->opcode = isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+		sqe->buf_index = slotIndex;
+	}
+	else
+	{
+		sqe->opcode = isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+	}
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)(buffer + done);
+	sqe->len = length;
+	sqe->off = fileOffset + done;
+	// Low bit tells reads and writes apart when the completion comes back
+	sqe->user_data = (slotIndex << 1) | (isWrite ? 1 : 0);
+	return sqe;
+}
+
+
+CopyStatus copyUring(int inFD, int outFD, size_t chunkSize)
+{
+	// Positioned I/O needs a real file with a known size on the source side
+	struct stat inStat;
+	if (fstat(inFD, &inStat) == -1 || !S_ISREG(inStat.st_mode))
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t inBase = lseek(inFD, 0, SEEK_CUR);
+	off_t outBase = lseek(outFD, 0, SEEK_CUR);
+	if (inBase == -1 || outBase == -1)
+	{
+		return CopyStatus::Unsupported;
+	}
+	off_t total = inStat.st_size > inBase ? inStat.st_size - inBase : 0;
+
+	Ring ring;
+	if (!setupRing(ring, URING_DEPTH * 2))
+	{
+		// io_uring missing (ENOSYS) or disabled by policy (EPERM)
+		teardownRing(ring);
+		return CopyStatus::Unsupported;
+	}
+
+	// One page aligned block carved into URING_DEPTH buffers
+	void *memory = nullptr;
+	if (posix_memalign(&memory, 4096, URING_DEPTH * chunkSize) != 0)
+	{
+		teardownRing(ring);
+		std::cerr << "Error allocating io_uring buffers." << std::endl;
+		return CopyStatus::Failed;
+	}
+	char *buffers = (char *)memory;
+
+	// Registering the buffers saves the kernel pinning them on every request.
+	// RLIMIT_MEMLOCK can forbid it, in which case plain READ/WRITE still work.
+	std::vector<iovec> iovecs(URING_DEPTH);
+	for (unsigned i = 0; i < URING_DEPTH; i++)
+	{
+		iovecs[i].iov_base = buffers + i * chunkSize;
+		iovecs[i].iov_len = chunkSize;
+	}
+	bool fixed = syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS,
+						 iovecs.data(), URING_DEPTH) == 0;
+
+	std::vector<Slot> slots(URING_DEPTH);
+	off_t nextChunk = 0;
+	CopyStatus status = CopyStatus::Done;
+	bool sourceEnded = false;
+	off_t copied = 0;
+	bool moved = false;			// Some request completed, the kernel accepts them
+
+	// A request failing before any other one has completed is how kernels and
+	// filesystems that refuse (fixed buffer) io_uring I/O show it, so that is
+	// reported like a failed ring setup and the caller falls back
+	auto fail = [&](int res, const char *message)
+	{
+		if (status != CopyStatus::Done)
+		{
+			return;
+		}
+		if (!moved && isRefusal(-res))
+		{
+			status = CopyStatus::Unsupported;
+			return;
+		}
+		std::cerr << message << std::endl;
+		status = CopyStatus::Failed;
+	};
+
+	// Decide what a slot needs next and queue it. A fresh chunk (or one whose
+	// read came back short) gets a read linked to its write, so the write is
+	// only issued once the data is in the buffer; a short write only needs
+	// the remaining bytes written again.
+	auto advance = [&](unsigned index)
+	{
+		Slot &slot = slots[index];
+		char *buffer = buffers + index * chunkSize;
+
+		if (slot.written < slot.readBytes)
+		{
+			queueIO(ring, true, fixed, outFD, buffer, index, slot.written,
+					slot.readBytes - slot.written, outBase + slot.offset);
+			slot.inFlight = 1;
+			slot.queuedAt = statStart();
+			return;
+		}
+		if (slot.written == slot.length || slot.eof)
+		{
+			copied += slot.written;
+			slot.active = false;
+			if (slot.eof)
+			{
+				sourceEnded = true;
+			}
+		}
+		if (!slot.active)
+		{
+			// Slot finished, hand it the next chunk of the file
+			if (sourceEnded || nextChunk >= total)
+			{
+				return;
+			}
+			slot = Slot();
+			slot.offset = nextChunk;
+			slot.length = std::min((off_t)chunkSize, total - nextChunk);
+			slot.active = true;
+			nextChunk += slot.length;
+		}
+
+		size_t remaining = slot.length - slot.readBytes;
+		io_uring_sqe *readSqe = queueIO(ring, false, fixed, inFD, buffer, index,
+										slot.readBytes, remaining, inBase + slot.offset);
+		readSqe->flags |= IOSQE_IO_LINK;
+		queueIO(ring, true, fixed, outFD, buffer, index, slot.written, remaining,
+				outBase + slot.offset);
+		slot.inFlight = 2;
+		slot.queuedAt = statStart();
+	};
+
+	for (unsigned i = 0; i < URING_DEPTH; i++)
+	{
+		advance(i);
+	}
+
+	unsigned outstanding = ring.toSubmit;
+	std::vector<unsigned> ready;		// Slots whose requests have all completed
+	ready.reserve(URING_DEPTH);
+	while (outstanding > 0 && status == CopyStatus::Done)
+	{
+		// Submit whatever was queued and wait for at least one completion
+		publishSqes(ring);
+		int entered = syscall(__NR_io_uring_enter, ring.fd, ring.toSubmit, 1,
+							  IORING_ENTER_GETEVENTS, NULL, 0);
+		if (entered == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			std::cerr << "Error submitting io_uring requests." << std::endl;
+			status = CopyStatus::Failed;
+			break;
+		}
+		ring.toSubmit -= entered;
+
+		unsigned head = *ring.cqHead;
+		unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+		ready.clear();
+		for (; head != tail; head++)
+		{
+			io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+			unsigned index = cqe->user_data >> 1;
+			bool isWrite = cqe->user_data & 1;
+			Slot &slot = slots[index];
+			outstanding--;
+			slot.inFlight--;
+			// Latency is queue to reap; a linked write includes its read
+			if (slot.queuedAt)
+			{
+				recordCall(isWrite ? StatCall::Write : StatCall::Read, slot.queuedAt, cqe->res);
+			}
+
+			if (!isWrite)
+			{
+				if (cqe->res < 0)
+				{
+					fail(cqe->res, "Error reading from source file.");
+				}
+				else if (cqe->res == 0)
+				{
+					slot.eof = true;		// File shrank under us, stop at what we have
+					moved = true;
+				}
+				else
+				{
+					slot.readBytes += cqe->res;
+					moved = true;
+				}
+			}
+			else if (cqe->res == -ECANCELED)
+			{
+				// Its linked read came back short, the write is requeued below
+			}
+			else if (cqe->res <= 0)
+			{
+				// Same rule as the buffered loop: a write that moves nothing is fatal,
+				// a partial one is simply resubmitted for the rest
+				fail(cqe->res, "Error writing to destination file.");
+			}
+			else
+			{
+				slot.written += cqe->res;
+				moved = true;
+			}
+
+			if (slot.inFlight == 0)
+			{
+				ready.push_back(index);
+			}
+		}
+		__atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+		if (status != CopyStatus::Done)
+		{
+			break;
+		}
+		unsigned queuedBefore = ring.toSubmit;
+		for (unsigned index : ready)
+		{
+			advance(index);
+		}
+		outstanding += ring.toSubmit - queuedBefore;
+	}
+
+	if (status != CopyStatus::Done && outstanding > 0)
+	{
+		// Let the kernel finish with our buffers before they are freed
+		while (outstanding > 0)
+		{
+			publishSqes(ring);
+			int entered = syscall(__NR_io_uring_enter, ring.fd, ring.toSubmit, 1,
+								  IORING_ENTER_GETEVENTS, NULL, 0);
+			if (entered == -1 && errno != EINTR)
+			{
+				break;
+			}
+			if (entered > 0)
+			{
+				ring.toSubmit -= entered;
+			}
+			unsigned head = *ring.cqHead;
+			unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+			outstanding -= tail - head;
+			__atomic_store_n(ring.cqHead, tail, __ATOMIC_RELEASE);
+		}
+	}
+
+	teardownRing(ring);
+	free(memory);
+
+	if (status == CopyStatus::Done)
+	{
+		seekPastCopy(inFD, outFD, inBase + copied, outBase + copied);
+	}
+	return status;
+}
+
@@ -0,0 +1,171 @@
+#include "logger.h"
+
+#include <iostream>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Formatted text is written once this much has built up
+static const size_t TEXT_CHUNK = 1 << 20;
+
+static const char LOG_MAGIC[8] = {'P', '0', '3', 'E', 'V', 'L', 'O', 'G'};
+static const uint32_t LOG_VERSION = 2;
+
+// The fixed part of each text line, after "Process N: " where there is one
+static const char* const STATE_TEXT[] = {
+    "Ready -> Running", nullptr, nullptr, "Hardware Interrupt: Timer interval",
+    "Running -> Ready", "Running -> Blocked", "Blocked -> Ready", "Running -> Halted"
+};
+
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+static void appendNumber(string &text, long long value) {
+    char digits[24];
+    char* end = to_chars(digits, digits + sizeof(digits), value).ptr;
+    text.append(digits, end);
+}
+
+bool Logger::open(const LogSinks &sinks, const Trace* traceData, bool tagCpuEvents) {
+    trace = traceData;
+    tagCpus = tagCpuEvents;
+    if (sinks.stdoutText)
+        textFDs.push_back(STDOUT_FILENO);
+    if (!sinks.textFile.empty()) {
+        int fd = ::open(sinks.textFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            cerr << "Error: Could not create " << sinks.textFile << endl;
+            return false;
+        }
+        textFDs.push_back(fd);
+        ownedFDs.push_back(fd);
+    }
+    if (!sinks.binaryFile.empty()) {
+        binaryFD = ::open(sinks.binaryFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (binaryFD == -1) {
+            cerr << "Error: Could not create " << sinks.binaryFile << endl;
+            return false;
+        }
+        ownedFDs.push_back(binaryFD);
+        // Header: magic, version, record size
+        char header[16];
+        uint32_t recordSize = sizeof(LogEvent);
+        memcpy(header, LOG_MAGIC, 8);
+        memcpy(header + 8, &LOG_VERSION, 4);
+        memcpy(header + 12, &recordSize, 4);
+        writeAll(binaryFD, header, sizeof(header));
+    }
+    if (textFDs.empty() && binaryFD == -1)
+        return true;
+
+    ring = vector<Block>(RING_BLOCKS);
+    current = &ring[0];
+    active = true;
+    writer = thread(&Logger::writerLoop, this);
+    return true;
+}
+
+void Logger::close() {
+    if (active) {
+        {
+            lock_guard<mutex> guard(lock);
+            if (current->count > 0)
+                head++;
+            stopping = true;
+        }
+        filled.notify_one();
+        writer.join();
+        active = false;
+    }
+    for (int fd : ownedFDs)
+        ::close(fd);
+    ownedFDs.clear();
+    textFDs.clear();
+    binaryFD = -1;
+}
+
+// Hand the full current block to the writer and move on to the next one,
+// waiting if the writer is a whole ring behind.
+void Logger::submit() {
+    unique_lock<mutex> guard(lock);
+    head++;
+    filled.notify_one();
+    drained.wait(guard, [this] { return head - tail < RING_BLOCKS; });
+    current = &ring[head % RING_BLOCKS];
+    current->count = 0;
+}
+
+void Logger::writerLoop() {
+    string text;
+    text.reserve(TEXT_CHUNK + 4096);
+    while (true) {
+        Block* block;
+        {
+            unique_lock<mutex> guard(lock);
+            filled.wait(guard, [this] { return tail < head || stopping; });
+            if (tail == head)
+                break;
+            block = &ring[tail % RING_BLOCKS];
+        }
+        writeBlock(*block, text);
+        {
+            lock_guard<mutex> guard(lock);
+            tail++;
+        }
+        drained.notify_one();
+    }
+    for (int fd : textFDs)
+        writeAll(fd, text.data(), text.size());
+}
+
+void Logger::writeBlock(const Block &block, string &text) {
+    if (binaryFD != -1)
+        writeAll(binaryFD, (const char*)block.events, block.count * sizeof(LogEvent));
+    if (textFDs.empty())
+        return;
+
+    for (size_t i = 0; i < block.count; i++) {
+        const LogEvent &event = block.events[i];
+        if (tagCpus && event.cpu >= 0) {
+            text += "[CPU ";
+            appendNumber(text, event.cpu);
+            text += "] ";
+        }
+        if (event.type == EV_SYSCALL) {
+            text += trace->text(event.text);
+        }
+        else if (event.type == EV_TIMER) {
+            text += STATE_TEXT[EV_TIMER];
+        }
+        else {
+            text += "Process ";
+            appendNumber(text, event.pid);
+            text += ": ";
+            if (event.type == EV_INSTRUCTION)
+                text += trace->text(event.text);
+            else
+                text += STATE_TEXT[event.type];
+        }
+        text += '\n';
+    }
+    if (text.size() >= TEXT_CHUNK) {
+        for (int fd : textFDs)
+            writeAll(fd, text.data(), text.size());
+        text.clear();
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "trace.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// What happened. Each type is one line of the text log.
+enum EventType : uint8_t {
+    EV_DISPATCHED,      // Process N: Ready -> Running
+    EV_INSTRUCTION,     // Process N: <text>
+    EV_SYSCALL,         // <text>, the SYS_CALL line as the process file had it
+    EV_TIMER,           // Hardware Interrupt: Timer interval
+    EV_PREEMPTED,       // Process N: Running -> Ready
+    EV_BLOCKED,         // Process N: Running -> Blocked
+    EV_UNBLOCKED,       // Process N: Blocked -> Ready
+    EV_HALTED           // Process N: Running -> Halted
+};
+
+// One structured log record, also the record format of the binary sink
+struct LogEvent {
+    int64_t time;       // globalTime of the event
+    int32_t pid;
+    uint32_t text;      // String table index, EV_INSTRUCTION and EV_SYSCALL only
+    int16_t cpu;        // -1 for events not on a CPU (unblocking)
+    uint8_t type;       // EventType
+    uint8_t reserved[5];
+};
+
+// Where the log goes: any combination, or none for a quiet run
+struct LogSinks {
+    bool stdoutText = true;             // Text lines on standard output
+    std::string textFile = "LOG.txt";   // Text lines to this file, empty for none
+    std::string binaryFile;             // LogEvent records to this file, empty for none
+};
+
+// Logs simulation events without slowing the simulation down. log() only
+// copies a 24-byte record into a block of a preallocated ring. Full blocks are
+// handed to a writer thread that formats them and writes the text in large
+// chunks, so there is no flush per line. The text is byte for byte what the
+// simulator always printed.
+class Logger {
+public:
+    Logger() {}
+    ~Logger() { close(); }
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    // Opens the sinks and starts the writer thread. trace supplies the
+    // instruction texts and must outlive the logger. With tagCpus, events on a
+    // CPU get a "[CPU k] " prefix. Returns false, with a message on stderr,
+    // if a file cannot be created.
+    bool open(const LogSinks &sinks, const Trace* trace, bool tagCpus);
+    // Writes out everything logged so far and stops the writer thread.
+    void close();
+
+    bool enabled() const { return active; }
+    void log(EventType type, int cpu, int pid, int64_t time, uint32_t text = 0) {
+        if (!active)
+            return;
+        current->events[current->count++] = {time, pid, text, (int16_t)cpu, type, {}};
+        if (current->count == BLOCK_EVENTS)
+            submit();
+    }
+
+private:
+    static const size_t BLOCK_EVENTS = 8192;
+    static const size_t RING_BLOCKS = 8;
+
+    struct Block {
+        LogEvent events[BLOCK_EVENTS];
+        size_t count = 0;
+    };
+
+    bool active = false;
+    const Trace* trace = nullptr;
+    bool tagCpus = false;
+    std::vector<int> textFDs;           // stdout and/or the text file
+    int binaryFD = -1;
+    std::vector<int> ownedFDs;          // The ones to close
+
+    // The ring: blocks [tail, head) are full and waiting for the writer,
+    // the simulation fills block head.
+    std::vector<Block> ring;
+    size_t head = 0;
+    size_t tail = 0;
+    bool stopping = false;
+    Block* current = nullptr;
+    std::mutex lock;
+    std::condition_variable filled;     // The writer waits for a full block
+    std::condition_variable drained;    // The simulation waits for a free block
+    std::thread writer;
+
+    void submit();
+    void writerLoop();
+    void writeBlock(const Block &block, std::string &text);
+};
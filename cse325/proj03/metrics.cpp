@@ -0,0 +1,67 @@
+#include "metrics.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void MetricsCollector::dispatched(int cpu, const Process &process) {
+    if (lastPID[cpu] != -1 && lastPID[cpu] != process.getPID())
+        switches++;
+    lastPID[cpu] = process.getPID();
+}
+
+void MetricsCollector::halted(const Process &process, SimTime now) {
+    turnarounds.push_back(now);
+    totalWaiting += process.stats.waitingTime;
+    if (process.getDeadline() != NO_DEADLINE) {
+        withDeadline++;
+        if (now > process.getDeadline())
+            missed++;
+    }
+}
+
+RunMetrics MetricsCollector::summarize(SimTime endTime) const {
+    RunMetrics metrics;
+    metrics.completed = turnarounds.size();
+    metrics.endTime = endTime;
+    metrics.contextSwitches = switches;
+    metrics.withDeadline = withDeadline;
+    metrics.deadlinesMissed = missed;
+    metrics.cpus = lastPID.size();
+    metrics.utilization = endTime > 0 ? (double)busyTime / ((double)endTime * lastPID.size()) : 0;
+    metrics.steals = steals;
+    metrics.migrations = migrations;
+    metrics.instructions = instructions;
+    if (turnarounds.empty())
+        return metrics;
+
+    long long total = 0;
+    for (SimTime turnaround : turnarounds)
+        total += turnaround;
+    metrics.avgTurnaround = (double)total / turnarounds.size();
+    metrics.avgWaiting = (double)totalWaiting / turnarounds.size();
+    metrics.throughput = endTime > 0 ? 1000.0 * turnarounds.size() / endTime : 0;
+
+    // Nearest-rank 99th percentile
+    vector<SimTime> sorted(turnarounds);
+    size_t rank = (sorted.size() * 99 + 99) / 100;
+    nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+    metrics.p99Turnaround = sorted[rank - 1];
+    return metrics;
+}
+
+void printMetrics(ostream &out, const string &policyName, const RunMetrics &metrics) {
+    out << "Policy: " << policyName << endl;
+    out << "Processes completed: " << metrics.completed << " in " << metrics.endTime << " time units ("
+        << metrics.throughput << " per 1000 time units)" << endl;
+    out << "Turnaround time: avg " << metrics.avgTurnaround << ", p99 " << metrics.p99Turnaround << endl;
+    out << "Waiting time: avg " << metrics.avgWaiting << endl;
+    out << "Context switches: " << metrics.contextSwitches << endl;
+    if (metrics.withDeadline > 0)
+        out << "Deadlines missed: " << metrics.deadlinesMissed << " of " << metrics.withDeadline << endl;
+    if (metrics.cpus > 1)
+        out << "CPUs: " << metrics.cpus << ", utilization " << metrics.utilization * 100 << "%, "
+            << metrics.steals << " steals, " << metrics.migrations << " migrations" << endl;
+    out << "Instructions executed: " << metrics.instructions << " in " << metrics.seconds << " s ("
+        << (long long)(metrics.seconds > 0 ? metrics.instructions / metrics.seconds : 0) << " per second)" << endl;
+}
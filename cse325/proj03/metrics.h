@@ -0,0 +1,59 @@
+#pragma once
+
+#include "process.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Summary of one simulation run
+struct RunMetrics {
+    int completed = 0;              // Processes that halted
+    SimTime endTime = 0;            // globalTime when the last one halted
+    double throughput = 0;          // Processes completed per 1000 time units
+    double avgTurnaround = 0;       // All processes arrive at time 0, so turnaround is the halt time
+    SimTime p99Turnaround = 0;
+    double avgWaiting = 0;          // Time spent in the ready queue
+    long long contextSwitches = 0;  // Dispatches of a different process than the one that ran last on that CPU
+    int withDeadline = 0;           // Processes that had a deadline
+    int deadlinesMissed = 0;        // ... and halted after it
+    int cpus = 1;
+    double utilization = 0;         // Share of CPU time spent running instructions or migrating
+    long long steals = 0;           // Processes an idle CPU took from another CPU's ready queue
+    long long migrations = 0;       // Dispatches on a different CPU than the process last ran on
+    long long instructions = 0;     // Instructions executed, normal and system calls
+    double seconds = 0;             // Wall-clock time the simulation took, which varies from run to run
+};
+
+// Collects the numbers for RunMetrics while the simulation runs
+class MetricsCollector {
+private:
+    std::vector<SimTime> turnarounds;
+    long long totalWaiting = 0;
+    long long switches = 0;
+    std::vector<int> lastPID;       // Per CPU
+    int withDeadline = 0;
+    int missed = 0;
+    long long busyTime = 0;         // Summed over all CPUs
+    long long steals = 0;
+    long long migrations = 0;
+    long long instructions = 0;
+
+public:
+    explicit MetricsCollector(int cpus = 1) : lastPID(cpus, -1) {}
+
+    // A process was dispatched on a CPU
+    void dispatched(int cpu, const Process &process);
+    // A process halted at time now
+    void halted(const Process &process, SimTime now);
+    // A CPU spent a time unit executing an instruction or paying for a migration
+    void busy() { busyTime++; }
+    void stole() { steals++; }
+    void migrated() { migrations++; }
+    // A CPU executed one instruction
+    void executed() { instructions++; }
+    RunMetrics summarize(SimTime endTime) const;
+};
+
+// Writes the report for --report, one item per line
+void printMetrics(std::ostream &out, const std::string &policyName, const RunMetrics &metrics);
@@ -0,0 +1,266 @@
+#include "policy.h"
+
+#include <queue>
+#include <deque>
+#include <set>
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+const char* POLICY_NAMES = "priority, rr, mlfq, cfs, edf";
+
+// Highest priority first, FIFO among equal priorities. A binary heap, so
+// inserting and dispatching are O(log n), and every insert (initial load,
+// timer preemption, unblocking) keeps the order.
+class PriorityPolicy : public SchedulingPolicy {
+private:
+    struct Entry {
+        int priority;
+        ProcessIndex process;
+        long long sequence;     // Insertion order, for FIFO among equal priorities
+    };
+    // Heap order: highest priority on top, then the earliest inserted
+    struct RunsLater {
+        bool operator()(const Entry &a, const Entry &b) const {
+            if (a.priority != b.priority)
+                return a.priority < b.priority;
+            return a.sequence > b.sequence;
+        }
+    };
+    priority_queue<Entry, vector<Entry>, RunsLater> heap;
+    long long nextSequence = 0;
+    int slice;
+
+public:
+    PriorityPolicy(const PolicyOptions &options, ProcessArena &arena) : SchedulingPolicy(arena), slice(options.quantum) {}
+
+    bool empty() const override { return heap.empty(); }
+    size_t size() const override { return heap.size(); }
+    void push(ProcessIndex process, ReadyReason, SimTime) override {
+        heap.push({processes[process].getPriority(), process, nextSequence++});
+    }
+    ProcessIndex pop(SimTime) override {
+        ProcessIndex process = heap.top().process;
+        heap.pop();
+        return process;
+    }
+    int quantum(ProcessIndex) const override { return slice; }
+};
+
+// Plain round robin: one FIFO queue, priorities ignored.
+class RoundRobinPolicy : public SchedulingPolicy {
+private:
+    deque<ProcessIndex> fifo;
+    int slice;
+
+public:
+    RoundRobinPolicy(const PolicyOptions &options, ProcessArena &arena) : SchedulingPolicy(arena), slice(options.quantum) {}
+
+    bool empty() const override { return fifo.empty(); }
+    size_t size() const override { return fifo.size(); }
+    void push(ProcessIndex process, ReadyReason, SimTime) override { fifo.push_back(process); }
+    ProcessIndex pop(SimTime) override {
+        ProcessIndex process = fifo.front();
+        fifo.pop_front();
+        return process;
+    }
+    int quantum(ProcessIndex) const override { return slice; }
+};
+
+// Multilevel feedback queue. New processes start at level 0. A process that
+// uses up its slice drops a level, where the slice doubles. One that blocks
+// keeps its level. To keep long jobs from starving, a process that has waited
+// agingInterval time units at its level moves up one level.
+class MlfqPolicy : public SchedulingPolicy {
+private:
+    // Each level is FIFO, so its front has waited the longest and aging
+    // only ever has to look at the fronts.
+    vector<deque<ProcessIndex>> levels;
+    size_t count = 0;
+    int baseQuantum;
+    int agingInterval;
+
+    void age(SimTime now) {
+        if (agingInterval <= 0)
+            return;
+        for (size_t level = 1; level < levels.size(); level++) {
+            while (!levels[level].empty()
+                   && now - processes[levels[level].front()].scheduling.levelSince >= agingInterval) {
+                ProcessIndex process = levels[level].front();
+                levels[level].pop_front();
+                processes[process].scheduling.level = level - 1;
+                processes[process].scheduling.levelSince = now;
+                levels[level - 1].push_back(process);
+            }
+        }
+    }
+
+public:
+    MlfqPolicy(const PolicyOptions &options, ProcessArena &arena)
+        : SchedulingPolicy(arena), levels(max(1, min(options.mlfqLevels, MAX_MLFQ_LEVELS))),
+          baseQuantum(options.quantum),
+          agingInterval(options.agingInterval) {}
+
+    bool empty() const override { return count == 0; }
+    size_t size() const override { return count; }
+    void push(ProcessIndex process, ReadyReason reason, SimTime now) override {
+        SchedulingInfo &info = processes[process].scheduling;
+        if (reason == ARRIVED)
+            info.level = 0;
+        else if (reason == PREEMPTED && info.level + 1 < (int)levels.size())
+            info.level++;
+        info.levelSince = now;
+        levels[info.level].push_back(process);
+        count++;
+    }
+    ProcessIndex pop(SimTime now) override {
+        age(now);
+        for (deque<ProcessIndex> &level : levels) {
+            if (!level.empty()) {
+                ProcessIndex process = level.front();
+                level.pop_front();
+                count--;
+                return process;
+            }
+        }
+        return NO_PROCESS;
+    }
+    // A large --quantum shifted up a few levels no longer fits an int, so the
+    // slice stops growing at INT_MAX
+    int quantum(ProcessIndex process) const override {
+        long long slice = (long long)baseQuantum << processes[process].scheduling.level;
+        return (int)min(slice, (long long)INT_MAX);
+    }
+};
+
+// CFS weight of each priority from -20 to 20, index priority + 20: 1024 at
+// priority 0 and 25% more per step, like the kernel's nice-to-weight table.
+// Computed once, so the policy only ever indexes it.
+static const array<long long, 41> CFS_WEIGHTS = [] {
+    array<long long, 41> weights;
+    for (int priority = -20; priority <= 20; priority++)
+        weights[priority + 20] = max(1LL, llround(1024 * pow(1.25, priority)));
+    return weights;
+}();
+
+// CFS-style fair scheduling. Each process accumulates virtual runtime, its
+// instructions run scaled down by its weight, and the process with the least
+// virtual runtime runs next. The ready processes are kept in a std::set, a
+// red-black tree, ordered by virtual runtime. Priority sets the weight: each
+// step of priority is worth 25% more CPU, like nice levels.
+class CfsPolicy : public SchedulingPolicy {
+private:
+    struct Entry {
+        long long vruntime;
+        long long sequence;     // Ties go to whoever was queued first
+        ProcessIndex process;
+        bool operator<(const Entry &other) const {
+            if (vruntime != other.vruntime)
+                return vruntime < other.vruntime;
+            return sequence < other.sequence;
+        }
+    };
+    set<Entry> tree;
+    long long nextSequence = 0;
+    long long minVruntime = 0;  // Never decreases, new and waking processes start here
+    long long queuedWeight = 0;
+    long long targetLatency;    // Time in which every ready process should get to run once
+    long long minGranularity;   // Shortest slice, the period stretches once the queue needs it
+
+    long long weight(ProcessIndex process) const {
+        return CFS_WEIGHTS[max(-20, min(20, processes[process].getPriority())) + 20];
+    }
+
+public:
+    CfsPolicy(const PolicyOptions &options, ProcessArena &arena)
+        : SchedulingPolicy(arena), targetLatency(options.quantum * 4LL), minGranularity(options.quantum) {}
+
+    bool empty() const override { return tree.empty(); }
+    size_t size() const override { return tree.size(); }
+    void push(ProcessIndex process, ReadyReason reason, SimTime) override {
+        // A process that was away does not get to catch up on the time it missed
+        long long &vruntime = processes[process].scheduling.vruntime;
+        if (reason != PREEMPTED)
+            vruntime = max(vruntime, minVruntime);
+        tree.insert({vruntime, nextSequence++, process});
+        queuedWeight += weight(process);
+    }
+    ProcessIndex pop(SimTime) override {
+        Entry first = *tree.begin();
+        tree.erase(tree.begin());
+        queuedWeight -= weight(first.process);
+        minVruntime = max(minVruntime, first.vruntime);
+        return first.process;
+    }
+    // A share of the scheduling period in proportion to the process's weight.
+    // Like the kernel, the period is the target latency until that would give
+    // the ready processes less than minGranularity each, then it grows with
+    // them, and no slice is shorter than minGranularity. Worked out in double
+    // since period * weight can pass a long long with millions of processes,
+    // and for a large --quantum the slice can exceed an int like the MLFQ slice.
+    int quantum(ProcessIndex process) const override {
+        long long own = weight(process);
+        long long running = (long long)tree.size() + 1;
+        long long period = max(targetLatency, running * minGranularity);
+        double share = max((double)minGranularity, (double)period * own / (queuedWeight + own));
+        return (int)min(share, (double)INT_MAX);
+    }
+    void ran(ProcessIndex process, int instructions) override {
+        processes[process].scheduling.vruntime += instructions * 1024LL * 1024 / weight(process);
+    }
+};
+
+// Earliest deadline first. Processes without a deadline run after all that
+// have one, FIFO. The timer still interrupts every quantum, which is when a
+// process that unblocked with an earlier deadline gets the CPU.
+class EdfPolicy : public SchedulingPolicy {
+private:
+    struct Entry {
+        int deadline;
+        ProcessIndex process;
+        long long sequence;
+    };
+    struct RunsLater {
+        bool operator()(const Entry &a, const Entry &b) const {
+            if (a.deadline != b.deadline)
+                return a.deadline > b.deadline;
+            return a.sequence > b.sequence;
+        }
+    };
+    priority_queue<Entry, vector<Entry>, RunsLater> heap;
+    long long nextSequence = 0;
+    int slice;
+
+public:
+    EdfPolicy(const PolicyOptions &options, ProcessArena &arena) : SchedulingPolicy(arena), slice(options.quantum) {}
+
+    bool empty() const override { return heap.empty(); }
+    size_t size() const override { return heap.size(); }
+    void push(ProcessIndex process, ReadyReason, SimTime) override {
+        heap.push({processes[process].getDeadline(), process, nextSequence++});
+    }
+    ProcessIndex pop(SimTime) override {
+        ProcessIndex process = heap.top().process;
+        heap.pop();
+        return process;
+    }
+    int quantum(ProcessIndex) const override { return slice; }
+};
+
+unique_ptr<SchedulingPolicy> makePolicy(const string &name, const PolicyOptions &options, ProcessArena &processes) {
+    if (name == "priority")
+        return unique_ptr<SchedulingPolicy>(new PriorityPolicy(options, processes));
+    if (name == "rr")
+        return unique_ptr<SchedulingPolicy>(new RoundRobinPolicy(options, processes));
+    if (name == "mlfq")
+        return unique_ptr<SchedulingPolicy>(new MlfqPolicy(options, processes));
+    if (name == "cfs")
+        return unique_ptr<SchedulingPolicy>(new CfsPolicy(options, processes));
+    if (name == "edf")
+        return unique_ptr<SchedulingPolicy>(new EdfPolicy(options, processes));
+    return nullptr;
+}
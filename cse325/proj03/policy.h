@@ -0,0 +1,61 @@
+#pragma once
+
+#include "process.h"
+
+#include <memory>
+#include <string>
+
+// Why a process is being put on the ready queue
+enum ReadyReason {
+    ARRIVED,        // Loaded at the start of the run
+    PREEMPTED,      // Used up its time slice
+    UNBLOCKED       // Its NETWORK or I/O call completed
+};
+
+// Most MLFQ levels (--levels). The slice doubles per level, so this also
+// bounds the longest slice.
+const int MAX_MLFQ_LEVELS = 16;
+
+// Knobs shared by the policies, set from the command line
+struct PolicyOptions {
+    int quantum = 5;            // Normal instructions per time slice (the base slice for MLFQ and CFS)
+    int mlfqLevels = 3;         // MLFQ: number of queues, level n gets quantum << n
+    int agingInterval = 50;     // MLFQ: time a process may wait before moving up a level
+};
+
+// A scheduling policy owns the ready queue: it decides which ready process
+// runs next and for how many normal instructions before the timer interrupt.
+// Processes are passed around as their index in the arena.
+class SchedulingPolicy {
+protected:
+    ProcessArena &processes;
+
+public:
+    explicit SchedulingPolicy(ProcessArena &arena) : processes(arena) {}
+    virtual ~SchedulingPolicy() {}
+
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+
+    // Adds a ready process. now is the current globalTime.
+    virtual void push(ProcessIndex process, ReadyReason reason, SimTime now) = 0;
+    // Removes and returns the process to run next. Only called when not empty().
+    virtual ProcessIndex pop(SimTime now) = 0;
+
+    // Normal instructions the process just dispatched may run before it is preempted.
+    virtual int quantum(ProcessIndex process) const = 0;
+    // Called when a process leaves the CPU after running the given number of normal instructions.
+    virtual void ran(ProcessIndex process, int instructions) { (void)process; (void)instructions; }
+};
+
+// Names accepted by --policy, for the usage message
+extern const char* POLICY_NAMES;
+
+// Creates the policy for a --policy name, or returns nullptr if the name is unknown.
+//   priority  highest priority first, FIFO among equals (the default)
+//   rr        round robin, FIFO regardless of priority
+//   mlfq      multilevel feedback queue with aging
+//   cfs       weighted virtual runtime, lowest first
+//   edf       earliest deadline first
+std::unique_ptr<SchedulingPolicy> makePolicy(const std::string &name, const PolicyOptions &options,
+                                             ProcessArena &processes);
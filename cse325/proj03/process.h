@@ -0,0 +1,83 @@
+#pragma once
+
+#include "trace.h"
+
+#include <cstdint>
+#include <vector>
+
+// Simulated time. 64 bits, so a run whose NETWORK and I/O waits add up past
+// INT32_MAX still keeps exact times.
+typedef int64_t SimTime;
+
+// Process States
+enum State { READY, RUNNING, BLOCKED, TERMINATED };
+
+// Bookkeeping the scheduler and its policies keep on each process
+struct SchedulingInfo {
+    int level = 0;              // MLFQ queue level, 0 is the highest
+    SimTime levelSince = 0;     // MLFQ: time the process entered its current queue
+    long long vruntime = 0;     // CFS: weighted instructions run, in 1/1024ths
+    int cpu = 0;                // --cpus: CPU whose ready queue the process goes back to
+    bool hasRun = false;        // Whether it has run on that CPU yet (a move after that is a migration)
+};
+
+// Per-process numbers for the end-of-run report
+struct ProcessStats {
+    SimTime readySince = 0;     // Time the process last entered the ready queue
+    long long waitingTime = 0;  // Total time spent in the ready queue
+};
+
+class Process {
+private:
+    int pid;
+    int priority;
+    int deadline;
+    State state;
+    // The instructions not run yet, records in the shared Trace
+    const uint32_t* nextRecord;
+    const uint32_t* endRecord;
+    // The "unblockTime" is the global time (i.e. number of instructions executed)
+    // at which the process will become ready again.
+    SimTime unblockTime;
+
+public:
+    SchedulingInfo scheduling;
+    ProcessStats stats;
+
+    Process(int id, int prio, int dl, const uint32_t* first, const uint32_t* end)
+        : pid(id), priority(prio), deadline(dl), state(READY), nextRecord(first), endRecord(end), unblockTime(0) {}
+
+    int getPID() const { return pid; }
+    int getPriority() const { return priority; }
+    int getDeadline() const { return deadline; }
+    State getState() const { return state; }
+    bool hasInstructions() const { return nextRecord != endRecord; }
+    // Returns and removes the next instruction.
+    Instruction getNextInstruction() { return Trace::decode(nextRecord); }
+    SimTime getUnblockTime() const { return unblockTime; }
+
+    void setState(State s) { state = s; }
+    void setUnblockTime(SimTime t) { unblockTime = t; }
+};
+
+// Index of a process in the ProcessArena. Queues hold these rather than pointers.
+typedef uint32_t ProcessIndex;
+const ProcessIndex NO_PROCESS = UINT32_MAX;
+
+// Every process of a run in one contiguous array, in the order they were
+// loaded, which is PID order. Processes are created once and never freed one
+// by one: a halted process stays in its slot, TERMINATED, until the run ends.
+class ProcessArena {
+private:
+    std::vector<Process> slots;
+
+public:
+    void reserve(size_t count) { slots.reserve(count); }
+    ProcessIndex add(const Process &process) {
+        slots.push_back(process);
+        return slots.size() - 1;
+    }
+    Process &operator[](ProcessIndex index) { return slots[index]; }
+    const Process &operator[](ProcessIndex index) const { return slots[index]; }
+    size_t size() const { return slots.size(); }
+};
@@ -1,250 +1,154 @@
 #include <iostream>
-#include <fstream>
-#include <queue>
-#include <vector>
-#include <string>
 #include <sstream>
+#include <string>
 #include <algorithm>
 #include <cctype>
 
-using namespace std;
-
-// Process States
-enum State { READY, RUNNING, BLOCKED, TERMINATED };
-
-class Process {
-private:
-    int pid;
-    int priority;
-    State state;
-    queue<string> instructions;
-    // The "unblockTime" is the global time (i.e. number of instructions executed) 
-    // at which the process will become ready again.
-    int unblockTime; 
-
-public:
-    Process(int id, int prio) : pid(id), priority(prio), state(READY), unblockTime(0) {}
-
-    int getPID() const { return pid; }
-    int getPriority() const { return priority; }
-    State getState() const { return state; }
-    bool hasInstructions() const { return !instructions.empty(); }
-    // Returns and removes the next instruction.
-    string getNextInstruction() {
-        string inst = instructions.front();
-        instructions.pop();
-        return inst;
-    }
-    int getUnblockTime() const { return unblockTime; }
-
-    void setState(State s) { state = s; }
-    void setUnblockTime(int t) { unblockTime = t; }
-    void addInstruction(const string &inst) { instructions.push(inst); }
-};
-
-// Global Data Structures
-vector<Process*> readyQueue;    // Ready Queue
-vector<Process*> blockedQueue;  // Blocked Queue
-Process* runningProcess = nullptr;  // Currently Running Process
-
-// Global time (counts the number of instructions executed)
-int globalTime = 0;             
-// Time slice counter for the currently running process (counts only normal instructions)
-int currentTimeSlice = 0;       
-ofstream logFile("LOG.txt");    // Log File Output
-
-// Function Declarations
-void loadProcesses(int numProcesses);
-void simulateExecution();
-/// executeInstruction returns true if a normal instruction was executed (and time advanced),
-/// or false if the instruction was a blocking/terminating one.
-bool executeInstruction(Process* process);
-void handleBlockedProcesses();
-void logEvent(const string &event);
-void sortReadyQueue();
+#include "simulator.h"
+#include "sweep.h"
 
+using namespace std;
 
-// Sort the ready queue by priority (higher priority first)
-void sortReadyQueue() {
-    sort(readyQueue.begin(), readyQueue.end(), [](Process* a, Process* b) {
-        return a->getPriority() > b->getPriority();
-    });
-}
+const char* USAGE = "Usage: ./proj03 <num_processes> [--convert <trace_file>] [--policy <name>] [--quantum <n>] "
+                    "[--levels <n>] [--aging <n>] [--cpus <n>] [--affinity] [--migration-cost <n>] [--report]\n"
+                    "       [--log <stdout,file,binary|none>] [--log-file <file>] [--binary-log <file>] [--quiet]\n"
+                    "       [--sweep <sweep_file> [--jobs <n>] [--csv <file>]]\n"
+                    "       ./proj03 --trace <trace_file> [options]\n"
+                    "       ./proj03 --sweep <sweep_file> [options]";
 
 // Main function
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: ./proj03 <num_processes>" << endl;
+    if (argc < 2) {
+        cerr << USAGE << endl;
         return 1;
     }
+    // The number of processes comes first, unless the processes come from --trace
     string arg = argv[1];
-    if (!all_of(arg.begin(), arg.end(), ::isdigit)) {
+    bool textInput = arg.empty() || arg[0] != '-';
+    if (textInput && !all_of(arg.begin(), arg.end(), ::isdigit)) {
         cerr << "Error: Argument must be a number (e.g., ./proj03 3)" << endl;
         return 1;
     }
-    int numProcesses = stoi(arg);
-    loadProcesses(numProcesses);
-    simulateExecution();
-    logFile.close();
-    return 0;
-}
 
-// Read process files (e.g., process1, process2, etc.) and load them into the ready queue.
-void loadProcesses(int numProcesses) {
-    for (int i = 1; i <= numProcesses; i++) {
-        string filename = "process" + to_string(i);
-        ifstream file(filename);
-        if (!file) {
-            cerr << "Error: Could not open " << filename << endl;
-            continue;
+    string traceFile;
+    string convertFile;
+    SimulatorConfig config;
+    SweepOptions sweep;
+    LogSinks sinks;
+    string sinkList = "stdout,file";
+    string binaryLog = "LOG.bin";
+    bool report = false;
+    for (int i = textInput ? 2 : 1; i < argc; i++) {
+        string option = argv[i];
+        // Options taking a number, and the range each accepts
+        int minimum = 0;
+        int maximum = NUMBER_LIMIT;
+        int* numberOption = option.compare(0, 2, "--") == 0
+                            ? findNumberSetting(config, option.substr(2), minimum, maximum) : nullptr;
+        if (option == "--report") {
+            report = true;
         }
-        int priority;
-        file >> priority;
-        Process* process = new Process(i, priority);
-        string line;
-        getline(file, line); // consume the rest of the line after priority
-        while (getline(file, line)) {
-            if (!line.empty())
-                process->addInstruction(line);
+        else if (option == "--affinity") {
+            config.pinned = true;
         }
-        readyQueue.push_back(process);
-        file.close();
-    }
-    sortReadyQueue();
-}
-
-// Main simulation loop.
-// Note: globalTime is incremented on every instruction execution (normal or blocking).
-// After a normal instruction execution, we call handleBlockedProcesses().
-void simulateExecution() {
-    // Continue until there are no processes left.
-    while (!readyQueue.empty() || runningProcess || !blockedQueue.empty()) {
-        // If no process is running, immediately select one from the ready queue.
-        if (!runningProcess && !readyQueue.empty()) {
-            runningProcess = readyQueue.front();
-            readyQueue.erase(readyQueue.begin());
-            runningProcess->setState(RUNNING);
-            currentTimeSlice = 0; // reset time slice counter
-            logEvent("Process " + to_string(runningProcess->getPID()) + ": Ready -> Running");
+        else if (option == "--quiet") {
+            sinkList = "none";
         }
-        // If a process is running, execute one instruction.
-        if (runningProcess) {
-            // executeInstruction returns true if a normal instruction was executed.
-            bool normalExecuted = executeInstruction(runningProcess);
-            // Only after a normal instruction do we check for unblocking.
-            if (normalExecuted) {
-                handleBlockedProcesses();
-            }
+        else if (option == "--log" && i + 1 < argc) {
+            sinkList = argv[++i];
         }
-        // If no process is running but readyQueue is nonempty, simply loop (do not advance time).
-    }
-}
-
-// executeInstruction executes one instruction from the running process.
-// It returns true if the instruction was normal (i.e. time advances and unblocking is checked),
-// or false if it was a blocking/termination instruction (or timer interrupt) so that time is not advanced again.
-bool executeInstruction(Process* process) {
-    if (!process->hasInstructions()) {
-        logEvent("Process " + to_string(process->getPID()) + ": Running -> Halted");
-        process->setState(TERMINATED);
-        delete process;
-        runningProcess = nullptr;
-        return false;
-    }
-    
-    string instruction = process->getNextInstruction();
-    
-    // Check if the instruction is a system call.
-    if (instruction.find("SYS_CALL") != string::npos) {
-        // Log the system call exactly as given.
-        logEvent(instruction);
-        // We'll parse the system call details.
-        size_t commaPos = instruction.find(',');
-        if (commaPos != string::npos) {
-            string callDetail = instruction.substr(commaPos + 1);
-            // Trim leading whitespace.
-            callDetail.erase(0, callDetail.find_first_not_of(" \t"));
-            stringstream ss(callDetail);
-            string type;
-            ss >> type;
-            
-            // For blocking calls (NETWORK or I/O), we increment time and then set unblockTime.
-            if (type == "NETWORK" || type == "I/O") {
-                string param;
-                ss >> param;
-                int duration = stoi(param);
-                // Increment globalTime for this instruction.
-                globalTime++;
-                // Set unblockTime = current globalTime + duration.
-                process->setUnblockTime(globalTime + duration);
-                logEvent("Process " + to_string(process->getPID()) + ": Running -> Blocked");
-                process->setState(BLOCKED);
-                blockedQueue.push_back(process);
-                runningProcess = nullptr;
-                // Return false so that we do not call handleBlockedProcesses immediately.
-                return false;
-            }
-            else if (type == "TERMINATE") {
-                // Increment globalTime.
-                globalTime++;
-                logEvent("Process " + to_string(process->getPID()) + ": Running -> Halted");
-                process->setState(TERMINATED);
-                delete process;
-                runningProcess = nullptr;
-                return false;
+        else if (option == "--log-file" && i + 1 < argc) {
+            sinks.textFile = argv[++i];
+        }
+        else if (option == "--binary-log" && i + 1 < argc) {
+            binaryLog = argv[++i];
+        }
+        else if (option == "--policy" && i + 1 < argc) {
+            config.policyName = argv[++i];
+        }
+        else if (option == "--trace" && i + 1 < argc) {
+            traceFile = argv[++i];
+        }
+        else if (option == "--convert" && i + 1 < argc) {
+            convertFile = argv[++i];
+        }
+        else if (option == "--sweep" && i + 1 < argc) {
+            sweep.file = argv[++i];
+        }
+        else if (option == "--csv" && i + 1 < argc) {
+            sweep.csvFile = argv[++i];
+        }
+        else if ((numberOption || option == "--jobs") && i + 1 < argc) {
+            int value;
+            if (numberOption == nullptr) {
+                numberOption = &sweep.jobs;
+                minimum = 1;
             }
-            else if (type == "ERROR") {
-                // Increment globalTime.
-                globalTime++;
-                logEvent("Process " + to_string(process->getPID()) + ": Running -> Halted");
-                process->setState(TERMINATED);
-                delete process;
-                runningProcess = nullptr;
-                return false;
+            if (!parseNumber(argv[++i], value) || value < minimum || value > maximum) {
+                cerr << "Error: " << option << " needs " << numberRequirement(minimum, maximum) << endl;
+                return 1;
             }
+            *numberOption = value;
         }
-    }
-    else {
-        // Normal instruction.
-        logEvent("Process " + to_string(process->getPID()) + ": " + instruction);
-        currentTimeSlice++;
-        // Increment globalTime.
-        globalTime++;
-        // Check for timer interrupt after 5 normal instructions.
-        if (currentTimeSlice == 5) {
-            logEvent("Hardware Interrupt: Timer interval");
-            logEvent("Process " + to_string(process->getPID()) + ": Running -> Ready");
-            process->setState(READY);
-            readyQueue.push_back(process);
-            runningProcess = nullptr;
-            return false;
+        else {
+            cerr << "Error: Unknown option '" << option << "'" << endl;
+            cerr << USAGE << endl;
+            return 1;
         }
-        // Return true to indicate a normal instruction was executed.
-        return true;
     }
-    // Should not reach here.
-    return false;
-}
+    // A sweep may name all its traces itself
+    bool hasWorkload = textInput || !traceFile.empty();
+    if ((textInput && !traceFile.empty()) || (!hasWorkload && sweep.file.empty())) {
+        cerr << "Error: Give either the number of processes or --trace <trace_file>" << endl;
+        return 1;
+    }
+    if (!convertFile.empty() && !textInput) {
+        cerr << "Error: --convert reads process files, give the number of processes" << endl;
+        return 1;
+    }
 
-// Check each blocked process. If globalTime is greater than or equal to its unblockTime, then unblock it.
-// (Processes in blockedQueue are kept in FIFO order.)
-void handleBlockedProcesses() {
-    vector<Process*> stillBlocked;
-    // Process blockedQueue in order.
-    for (auto process : blockedQueue) {
-        if (globalTime >= process->getUnblockTime()) {
-            logEvent("Process " + to_string(process->getPID()) + ": Blocked -> Ready");
-            process->setState(READY);
-            readyQueue.push_back(process);
-        } else {
-            stillBlocked.push_back(process);
+    // Sinks: any of stdout, file and binary, or none
+    bool logStdout = false, logFile = false, logBinary = false;
+    if (sinkList != "none") {
+        stringstream list(sinkList);
+        string sink;
+        while (getline(list, sink, ',')) {
+            bool &selected = sink == "stdout" ? logStdout : sink == "file" ? logFile : logBinary;
+            if (sink != "stdout" && sink != "file" && sink != "binary") {
+                cerr << "Error: Unknown log sink '" << sink << "' (choose from stdout, file, binary, none)" << endl;
+                return 1;
+            }
+            selected = true;
         }
     }
-    blockedQueue = stillBlocked;
-}
+    sinks.stdoutText = logStdout;
+    if (!logFile)
+        sinks.textFile.clear();
+    if (logBinary)
+        sinks.binaryFile = binaryLog;
+
+    Trace trace;
+    if (hasWorkload && (textInput ? !trace.loadText(stoi(arg)) : !trace.loadBinary(traceFile)))
+        return 1;
+    // Convert only: write the binary trace and stop
+    if (!convertFile.empty()) {
+        if (!trace.save(convertFile))
+            return 1;
+        cout << "Wrote " << trace.processes().size() << " processes to " << convertFile << endl;
+        return 0;
+    }
+    // Sweep: every run quiet, the metrics to the CSV file
+    if (!sweep.file.empty()) {
+        string traceName = textInput ? "process1-" + arg : traceFile;
+        return runSweep(sweep, config, hasWorkload ? &trace : nullptr, traceName) ? 0 : 1;
+    }
 
-// Log an event to both standard output and LOG.txt.
-void logEvent(const string &event) {
-    cout << event << endl;
-    logFile << event << endl;
+    Simulator simulator(trace);
+    if (!simulator.open(config, sinks))
+        return 1;
+    RunMetrics metrics = simulator.run();
+    // The report goes to stderr so stdout stays the same as LOG.txt
+    if (report)
+        printMetrics(cerr, config.policyName, metrics);
+    return 0;
 }
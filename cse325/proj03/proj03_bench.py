@@ -0,0 +1,122 @@
+import argparse
+import csv
+import os
+import subprocess
+import sys
+
+# Every --policy proj03 accepts, and the ready queue each one is built on
+POLICIES = {
+    "priority": "binary heap",
+    "rr": "FIFO",
+    "mlfq": "FIFO per level",
+    "cfs": "red-black tree",
+    "edf": "binary heap",
+}
+
+DEFAULT_PROCESSES = "10,100,1K,10K,100K,1M"
+
+CSV_FIELDS = ["processes", "policy", "ready_queue", "cpus", "status", "instructions", "sim_s",
+              "instructions_per_s", "peak_rss_kb", "end_time", "context_switches"]
+
+
+def parse_count(text):
+    units = {"K": 1000, "M": 1000000}
+    text = text.strip().upper()
+    if text and text[-1] in units:
+        return int(text[:-1]) * units[text[-1]]
+    return int(text)
+
+
+def generate(generator, path, processes, args):
+    """Write a seeded workload of this many processes as a binary trace."""
+    cmd = [generator, path, "--processes", str(processes), "--seed", str(args.seed),
+           "--io-percent", str(args.io_percent), "--priority", args.priority, "--deadline-percent", "20"]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+
+
+def run_policy(program, trace, policy, cpus):
+    """Run proj03 once, quiet, with --report and return one CSV row. Peak RSS
+    comes from the kernel's accounting for the child, wait4's ru_maxrss."""
+    cmd = [program, "--trace", trace, "--policy", policy, "--cpus", str(cpus), "--quiet", "--report"]
+    process = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    # The report is a few lines, so it cannot fill the pipe before the child exits
+    _, status, usage = os.wait4(process.pid, 0)
+    process.returncode = os.waitstatus_to_exitcode(status)
+    report = process.stderr.read()
+    process.stderr.close()
+
+    row = {"policy": policy, "ready_queue": POLICIES[policy], "cpus": cpus,
+           "status": "ok" if process.returncode == 0 else "failed", "peak_rss_kb": usage.ru_maxrss}
+    for line in report.splitlines():
+        # Instructions executed: N in S s (R per second)
+        if line.startswith("Instructions executed: "):
+            words = line.split()
+            row["instructions"] = int(words[2])
+            row["sim_s"] = float(words[4])
+            row["instructions_per_s"] = int(words[6].lstrip("("))
+        # Processes completed: N in T time units (...)
+        elif line.startswith("Processes completed: "):
+            row["end_time"] = int(line.split()[4])
+        elif line.startswith("Context switches: "):
+            row["context_switches"] = int(line.split()[2])
+    if row["status"] != "ok":
+        print(f"  {policy} failed: {report.strip()}", file=sys.stderr)
+    return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark every proj03 policy over generated workloads.")
+    parser.add_argument("--program", default="./proj03", help="proj03 binary (default ./proj03)")
+    parser.add_argument("--generator", default="./workload", help="workload generator (default ./workload)")
+    parser.add_argument("--dir", default="bench_data", help="scratch directory for the traces")
+    parser.add_argument("--csv", default="bench.csv", help="CSV file to write (default bench.csv)")
+    parser.add_argument("--processes", default=DEFAULT_PROCESSES,
+                        help=f"workload sizes (default {DEFAULT_PROCESSES})")
+    parser.add_argument("--max-processes", default=None, help="skip sizes above this, e.g. 100K")
+    parser.add_argument("--policies", default=",".join(POLICIES), help="policies to run (default all)")
+    parser.add_argument("--cpus", type=int, default=1, help="--cpus for every run (default 1)")
+    parser.add_argument("--seed", type=int, default=1, help="workload seed (default 1)")
+    parser.add_argument("--io-percent", type=int, default=30, help="share of I/O-bound processes (default 30)")
+    parser.add_argument("--priority", default="uniform", help="uniform, skewed or equal (default uniform)")
+    parser.add_argument("--repeat", type=int, default=1, help="runs per combination (default 1)")
+    args = parser.parse_args()
+
+    for program in (args.program, args.generator):
+        if not os.path.exists(program):
+            print(f"Error: '{program}' not found, run make first.")
+            sys.exit(1)
+    sizes = [parse_count(s) for s in args.processes.split(",")]
+    if args.max_processes:
+        sizes = [s for s in sizes if s <= parse_count(args.max_processes)]
+    policies = args.policies.split(",")
+    for policy in policies:
+        if policy not in POLICIES:
+            print(f"Error: Unknown policy '{policy}'.")
+            sys.exit(1)
+
+    os.makedirs(args.dir, exist_ok=True)
+    trace = os.path.join(args.dir, "bench.trace")
+    rows = 0
+    with open(args.csv, "w", newline="") as out:
+        writer = csv.DictWriter(out, fieldnames=CSV_FIELDS)
+        writer.writeheader()
+        for size in sizes:
+            print(f"Generating {size} processes...")
+            generate(args.generator, trace, size, args)
+            for policy in policies:
+                for _ in range(args.repeat):
+                    row = run_policy(args.program, trace, policy, args.cpus)
+                    row["processes"] = size
+                    writer.writerow(row)
+                    out.flush()
+                    rows += 1
+                    print(f"  {policy:<9} {row.get('instructions_per_s', '-'):>12} instructions/s  "
+                          f"{row['peak_rss_kb']:>9} KB peak RSS  {row['status']}")
+            os.remove(trace)
+    if not os.listdir(args.dir):
+        os.rmdir(args.dir)
+    print(f"\n{rows} runs written to {args.csv}")
+
+
+if __name__ == "__main__":
+    main()
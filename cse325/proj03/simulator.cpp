@@ -0,0 +1,267 @@
+#include "simulator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+using namespace std;
+
+bool Simulator::open(const SimulatorConfig &runConfig, const LogSinks &sinks) {
+    config = runConfig;
+    // Every CPU gets its own instance of the policy
+    cpus.resize(config.cpus);
+    for (Cpu &cpu : cpus) {
+        cpu.readyQueue = makePolicy(config.policyName, config.options, processes);
+        if (!cpu.readyQueue) {
+            cerr << "Error: Unknown policy '" << config.policyName << "' (choose from " << POLICY_NAMES << ")" << endl;
+            return false;
+        }
+    }
+    metrics = MetricsCollector(config.cpus);
+    return logger.open(sinks, &trace, cpus.size() > 1);
+}
+
+RunMetrics Simulator::run() {
+    auto start = chrono::steady_clock::now();
+    loadProcesses();
+    simulateExecution();
+    logger.close();
+    RunMetrics summary = metrics.summarize(globalTime);
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+// Create a process for each one in the trace (process1, process2, etc.) and load them into the ready queue.
+void Simulator::loadProcesses() {
+    processes.reserve(trace.processes().size());
+    for (const TraceProcess &loaded : trace.processes()) {
+        const uint32_t* first = trace.words() + loaded.firstWord;
+        ProcessIndex index = processes.add(Process(loaded.pid, loaded.priority, loaded.deadline,
+                                                   first, first + loaded.wordCount));
+        // Processes are dealt out to the CPUs in turn
+        processes[index].scheduling.cpu = (loaded.pid - 1) % cpus.size();
+        makeReady(index, ARRIVED, globalTime);
+    }
+}
+
+// Main simulation loop.
+// The CPUs run in lock-step: each round, every CPU in turn dispatches a process
+// if it is idle and executes one instruction. Time advances by one after a round
+// in which any CPU executed an instruction that takes time, so events from that
+// round happen at globalTime + 1. With one CPU this is the original loop: time
+// advances on every normal or blocking instruction, and after a normal
+// instruction we call handleBlockedProcesses().
+void Simulator::simulateExecution() {
+    // Continue until there are no processes left.
+    while (readyCount || runningCount || !blockedQueue.empty()) {
+        // Nothing can run until a blocked process unblocks. Time only advances
+        // when instructions execute, so skip straight to the next unblock.
+        if (!runningCount && !readyCount) {
+            globalTime = max(globalTime, blockedQueue.top().unblockTime);
+            handleBlockedProcesses();
+        }
+        bool timePassed = false;
+        bool checkUnblock = false;
+        for (size_t cpu = 0; cpu < cpus.size(); cpu++) {
+            // If no process is running, immediately select one.
+            if (cpus[cpu].runningProcess == NO_PROCESS && !dispatch(cpu))
+                continue;
+            StepResult result = step(cpu);
+            timePassed |= result != NO_TIME;
+            // Only after a normal instruction do we check for unblocking.
+            checkUnblock |= result == NORMAL_STEP;
+        }
+        if (timePassed)
+            globalTime++;
+        if (checkUnblock)
+            handleBlockedProcesses();
+    }
+}
+
+// Give an idle CPU a process: the next one in its own ready queue or, if that is
+// empty, one stolen from the CPU with the longest ready queue. Returns false if
+// there is nothing to run.
+bool Simulator::dispatch(int cpuIndex) {
+    Cpu &cpu = cpus[cpuIndex];
+    SchedulingPolicy* source = cpu.readyQueue.get();
+    if (source->empty()) {
+        if (config.pinned)
+            return false;
+        // Ties go to the lowest numbered CPU, so runs are repeatable
+        size_t busiest = 0;
+        for (size_t other = 1; other < cpus.size(); other++) {
+            if (cpus[other].readyQueue->size() > cpus[busiest].readyQueue->size())
+                busiest = other;
+        }
+        source = cpus[busiest].readyQueue.get();
+        if (source->empty())
+            return false;
+        metrics.stole();
+    }
+
+    ProcessIndex index = source->pop(globalTime);
+    Process &process = processes[index];
+    readyCount--;
+    runningCount++;
+    cpu.runningProcess = index;
+    process.setState(RUNNING);
+    // A process preempted earlier in this round may be taken by a later CPU right away
+    process.stats.waitingTime += max((SimTime)0, globalTime - process.stats.readySince);
+    SchedulingInfo &info = process.scheduling;
+    cpu.migrationStall = 0;
+    if (info.hasRun && info.cpu != cpuIndex) {
+        metrics.migrated();
+        cpu.migrationStall = config.migrationCost;
+    }
+    info.cpu = cpuIndex;
+    info.hasRun = true;
+    metrics.dispatched(cpuIndex, process);
+    cpu.currentTimeSlice = 0; // reset time slice counter
+    cpu.currentQuantum = cpu.readyQueue->quantum(index);
+    logger.log(EV_DISPATCHED, cpuIndex, process.getPID(), globalTime);
+    return true;
+}
+
+// step executes one instruction from the running process on a CPU.
+// It returns NORMAL_STEP if the instruction was normal (i.e. time advances and unblocking is checked),
+// TIME_PASSED if it was a blocking/termination instruction (or timer interrupt) so that unblocking waits,
+// or NO_TIME if it did not take time.
+Simulator::StepResult Simulator::step(int cpuIndex) {
+    Cpu &cpu = cpus[cpuIndex];
+    ProcessIndex index = cpu.runningProcess;
+    Process &process = processes[index];
+    // Instructions that take time finish at the end of this round
+    SimTime now = globalTime + 1;
+    if (cpu.migrationStall > 0) {
+        cpu.migrationStall--;
+        metrics.busy();
+        return TIME_PASSED;
+    }
+    if (!process.hasInstructions()) {
+        haltProcess(cpuIndex, globalTime);
+        return NO_TIME;
+    }
+
+    Instruction instruction = process.getNextInstruction();
+    metrics.executed();
+
+    if (instruction.op == OP_NORMAL) {
+        // Normal instruction.
+        logger.log(EV_INSTRUCTION, cpuIndex, process.getPID(), now, instruction.text);
+        cpu.currentTimeSlice++;
+        metrics.busy();
+        // Check for timer interrupt once the policy's time slice is used up.
+        if (cpu.currentTimeSlice >= cpu.currentQuantum) {
+            logger.log(EV_TIMER, cpuIndex, process.getPID(), now);
+            logger.log(EV_PREEMPTED, cpuIndex, process.getPID(), now);
+            cpu.readyQueue->ran(index, cpu.currentTimeSlice);
+            makeReady(index, PREEMPTED, now);
+            cpu.runningProcess = NO_PROCESS;
+            runningCount--;
+            return TIME_PASSED;
+        }
+        // A normal instruction was executed.
+        return NORMAL_STEP;
+    }
+
+    // A system call: log it exactly as given.
+    logger.log(EV_SYSCALL, cpuIndex, process.getPID(), instruction.op == OP_SYSCALL ? globalTime : now,
+               instruction.text);
+    // For blocking calls (NETWORK or I/O), time passes and then unblockTime is set.
+    if (instruction.op == OP_NETWORK || instruction.op == OP_IO) {
+        metrics.busy();
+        // Set unblockTime = time after this instruction + duration.
+        process.setUnblockTime(now + instruction.duration);
+        logger.log(EV_BLOCKED, cpuIndex, process.getPID(), now);
+        process.setState(BLOCKED);
+        cpu.readyQueue->ran(index, cpu.currentTimeSlice);
+        blockedQueue.push({process.getUnblockTime(), index, blockSequence++});
+        cpu.runningProcess = NO_PROCESS;
+        runningCount--;
+        // Do not call handleBlockedProcesses for this instruction.
+        return TIME_PASSED;
+    }
+    if (instruction.op == OP_TERMINATE || instruction.op == OP_ERROR) {
+        metrics.busy();
+        haltProcess(cpuIndex, now);
+        return TIME_PASSED;
+    }
+    // Unknown system call: logged, takes no time, and the process keeps running.
+    return NO_TIME;
+}
+
+// Unblock every blocked process whose unblockTime has been reached (globalTime >= unblockTime).
+// They are moved to the ready queue in the order they blocked.
+void Simulator::handleBlockedProcesses() {
+    if (blockedQueue.empty() || blockedQueue.top().unblockTime > globalTime)
+        return;
+    unblocked.clear();
+    while (!blockedQueue.empty() && blockedQueue.top().unblockTime <= globalTime) {
+        unblocked.push_back(blockedQueue.top());
+        blockedQueue.pop();
+    }
+    sort(unblocked.begin(), unblocked.end(), [](const BlockedEntry &a, const BlockedEntry &b) {
+        return a.sequence < b.sequence;
+    });
+    for (const BlockedEntry &entry : unblocked) {
+        logger.log(EV_UNBLOCKED, -1, processes[entry.process].getPID(), globalTime);
+        makeReady(entry.process, UNBLOCKED, globalTime);
+    }
+}
+
+// Put a process on the ready queue of the CPU it last ran on (or was loaded on).
+void Simulator::makeReady(ProcessIndex index, ReadyReason reason, SimTime now) {
+    Process &process = processes[index];
+    process.setState(READY);
+    process.stats.readySince = now;
+    cpus[process.scheduling.cpu].readyQueue->push(index, reason, now);
+    readyCount++;
+}
+
+// The process running on a CPU halts at time now: it ran out of instructions or
+// called TERMINATE or ERROR.
+void Simulator::haltProcess(int cpuIndex, SimTime now) {
+    Cpu &cpu = cpus[cpuIndex];
+    ProcessIndex index = cpu.runningProcess;
+    Process &process = processes[index];
+    logger.log(EV_HALTED, cpuIndex, process.getPID(), now);
+    // The process keeps its slot in the arena, there is nothing to free
+    process.setState(TERMINATED);
+    cpu.readyQueue->ran(index, cpu.currentTimeSlice);
+    metrics.halted(process, now);
+    cpu.runningProcess = NO_PROCESS;
+    runningCount--;
+}
+
+bool parseNumber(const string &text, int &value) {
+    if (text.empty() || text.size() > 9 || !all_of(text.begin(), text.end(), ::isdigit))
+        return false;
+    value = stoi(text);
+    return true;
+}
+
+int* findNumberSetting(SimulatorConfig &config, const string &name, int &minimum, int &maximum) {
+    struct NumberSetting { const char* name; int* value; int minimum; int maximum; };
+    const NumberSetting settings[] = {
+        {"quantum", &config.options.quantum, 1, NUMBER_LIMIT},
+        {"levels", &config.options.mlfqLevels, 1, MAX_MLFQ_LEVELS},
+        {"aging", &config.options.agingInterval, 0, NUMBER_LIMIT},
+        {"cpus", &config.cpus, 1, MAX_CPUS},
+        {"migration-cost", &config.migrationCost, 0, NUMBER_LIMIT},
+    };
+    for (const NumberSetting &setting : settings) {
+        if (name == setting.name) {
+            minimum = setting.minimum;
+            maximum = setting.maximum;
+            return setting.value;
+        }
+    }
+    return nullptr;
+}
+
+string numberRequirement(int minimum, int maximum) {
+    if (maximum < NUMBER_LIMIT)
+        return "a number from " + to_string(minimum) + " to " + to_string(maximum);
+    return minimum ? "a positive number" : "a whole number";
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "process.h"
+#include "policy.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
+
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Everything that sets up one simulation run, apart from the workload
+struct SimulatorConfig {
+    std::string policyName = "priority";
+    PolicyOptions options;
+    int cpus = 1;
+    bool pinned = false;            // --affinity: processes never leave the CPU they were loaded on
+    int migrationCost = 0;          // --migration-cost: stall when a process runs on a new CPU
+};
+
+// One run of the scheduler over a trace. All the state of the run lives here,
+// so several simulators can run at once on different threads (--sweep) as long
+// as each has its own. The trace is only read and may be shared.
+class Simulator {
+public:
+    explicit Simulator(const Trace &trace) : trace(trace) {}
+    Simulator(const Simulator &) = delete;
+    Simulator &operator=(const Simulator &) = delete;
+
+    // Creates the CPUs and their ready queues and opens the log sinks.
+    // Returns false, with a message on stderr, on an unknown policy or a log
+    // file that cannot be created.
+    bool open(const SimulatorConfig &config, const LogSinks &sinks);
+    // Loads the processes, runs them all to the end and closes the log.
+    RunMetrics run();
+
+private:
+    // A blocked process and the order it blocked in. Processes that become ready
+    // at the same check are moved to the ready queue in that order.
+    struct BlockedEntry {
+        SimTime unblockTime;
+        ProcessIndex process;
+        long long sequence;
+    };
+
+    // Heap order for the blocked queue: earliest unblockTime on top
+    struct UnblocksLater {
+        bool operator()(const BlockedEntry &a, const BlockedEntry &b) const {
+            if (a.unblockTime != b.unblockTime)
+                return a.unblockTime > b.unblockTime;
+            return a.sequence > b.sequence;
+        }
+    };
+
+    // One simulated CPU: its running slot and its own ready queue
+    struct Cpu {
+        std::unique_ptr<SchedulingPolicy> readyQueue;   // Ready Queue, ordered by the --policy
+        ProcessIndex runningProcess = NO_PROCESS;       // Currently Running Process
+        // Time slice counter for the running process (counts only normal instructions)
+        int currentTimeSlice = 0;
+        // Normal instructions the running process may execute before the timer interrupt
+        int currentQuantum = 0;
+        // Time units left before the running process, just migrated here, starts executing
+        int migrationStall = 0;
+    };
+
+    // What one step of a CPU did
+    enum StepResult {
+        NO_TIME,        // Nothing that takes time (dispatch only, halt at the end of the instructions, unknown SYS_CALL)
+        TIME_PASSED,    // A blocking, halting or preempted instruction, or a migration stall
+        NORMAL_STEP     // A normal instruction the process keeps running after: check for unblocking
+    };
+
+    const Trace &trace;             // Every process's instructions, from the process files or --trace
+    SimulatorConfig config;
+    ProcessArena processes;         // Every process, indexed by load (PID) order
+    std::vector<Cpu> cpus;          // --cpus, one by default
+    size_t readyCount = 0;          // Processes in all the ready queues
+    size_t runningCount = 0;        // CPUs with a running process
+    // Blocked Queue, a min-heap on unblockTime so checking for processes to
+    // unblock only looks at the top instead of scanning every blocked process
+    std::priority_queue<BlockedEntry, std::vector<BlockedEntry>, UnblocksLater> blockedQueue;
+    long long blockSequence = 0;    // Number of times a process has blocked
+    std::vector<BlockedEntry> unblocked;    // Scratch space for handleBlockedProcesses()
+
+    // Global time (counts the number of instructions executed, by any one CPU)
+    SimTime globalTime = 0;
+    Logger logger;                  // Log Output, to stdout and LOG.txt by default
+    MetricsCollector metrics;       // Numbers for --report
+
+    void loadProcesses();
+    void simulateExecution();
+    bool dispatch(int cpu);
+    /// step runs one instruction (or migration stall) on a CPU and says whether time passed.
+    StepResult step(int cpu);
+    void handleBlockedProcesses();
+    void makeReady(ProcessIndex index, ReadyReason reason, SimTime now);
+    void haltProcess(int cpu, SimTime now);
+};
+
+// Largest value parseNumber() accepts, and so the limit of settings without a
+// tighter one
+const int NUMBER_LIMIT = 999999999;
+// Most simulated CPUs (--cpus)
+const int MAX_CPUS = 64;
+
+// Parses a whole-number option value, false if it is not one.
+bool parseNumber(const std::string &text, int &value);
+// The setting of config that takes a whole number under this name, the
+// command-line option without its dashes (quantum, levels, aging, cpus,
+// migration-cost), and the range of values it accepts. nullptr for any other name.
+int* findNumberSetting(SimulatorConfig &config, const std::string &name, int &minimum, int &maximum);
+// What a setting with this range needs, for error messages: "a positive
+// number", "a whole number" or "a number from 1 to 64"
+std::string numberRequirement(int minimum, int maximum);
@@ -0,0 +1,208 @@
+#include "sweep.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+// One run of the sweep
+struct SweepRun {
+    string traceName;
+    const Trace* trace;
+    SimulatorConfig config;
+};
+
+static vector<string> splitList(const string &text) {
+    vector<string> values;
+    stringstream list(text);
+    string value;
+    while (getline(list, value, ','))
+        values.push_back(value);
+    return values;
+}
+
+// Applies one key=value setting to a run. Returns false, with the reason in error.
+static bool applySetting(SweepRun &run, const string &key, const string &value,
+                         map<string, unique_ptr<Trace>> &traces, string &error) {
+    int minimum, maximum;
+    if (key == "policy") {
+        run.config.policyName = value;
+    }
+    else if (key == "affinity") {
+        if (value != "0" && value != "1") {
+            error = "affinity must be 0 or 1";
+            return false;
+        }
+        run.config.pinned = value == "1";
+    }
+    else if (key == "trace") {
+        // Each trace is loaded once and shared by every run that uses it
+        unique_ptr<Trace> &trace = traces[value];
+        if (!trace) {
+            trace.reset(new Trace());
+            if (!trace->loadBinary(value)) {
+                error = "cannot load trace '" + value + "'";
+                return false;
+            }
+        }
+        run.traceName = value;
+        run.trace = trace.get();
+    }
+    else if (int* setting = findNumberSetting(run.config, key, minimum, maximum)) {
+        int number;
+        if (!parseNumber(value, number) || number < minimum || number > maximum) {
+            error = key + " needs " + numberRequirement(minimum, maximum);
+            return false;
+        }
+        *setting = number;
+    }
+    else {
+        error = "unknown key '" + key + "'";
+        return false;
+    }
+    return true;
+}
+
+// Reads the sweep file into the list of runs, in order.
+static bool readSweep(const SweepOptions &sweep, const SweepRun &base, vector<SweepRun> &runs,
+                      map<string, unique_ptr<Trace>> &traces) {
+    ifstream file(sweep.file);
+    if (!file) {
+        cerr << "Error: Could not open " << sweep.file << endl;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        stringstream settings(line);
+        string setting;
+        vector<SweepRun> expanded = {base};
+        bool any = false;
+        string error;
+        while (settings >> setting) {
+            if (setting[0] == '#' && !any)
+                break;
+            any = true;
+            size_t equals = setting.find('=');
+            if (equals == string::npos || equals == 0 || equals + 1 == setting.size()) {
+                error = "expected key=value, got '" + setting + "'";
+                break;
+            }
+            string key = setting.substr(0, equals);
+            vector<string> values = splitList(setting.substr(equals + 1));
+            // Every run so far, once with each value
+            vector<SweepRun> next;
+            for (const SweepRun &run : expanded) {
+                for (const string &value : values) {
+                    next.push_back(run);
+                    if (!applySetting(next.back(), key, value, traces, error))
+                        break;
+                }
+                if (!error.empty())
+                    break;
+            }
+            if (!error.empty())
+                break;
+            expanded.swap(next);
+        }
+        for (const SweepRun &run : expanded) {
+            if (!error.empty() || !any)
+                break;
+            if (!run.trace) {
+                error = "no trace: give trace=<file>, or a workload on the command line";
+                break;
+            }
+            // A simulator that is opened but never run checks the rest, like the policy name
+            Simulator check(*run.trace);
+            if (!check.open(run.config, LogSinks{false, "", ""}))
+                error = "invalid settings";
+        }
+        if (!error.empty()) {
+            cerr << "Error: " << sweep.file << " line " << lineNumber << ": " << error << endl;
+            return false;
+        }
+        if (any)
+            runs.insert(runs.end(), expanded.begin(), expanded.end());
+    }
+    return true;
+}
+
+// A CSV field, quoted if it needs to be
+static string csvField(const string &text) {
+    if (text.find_first_of(",\"\n") == string::npos)
+        return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void writeCsv(ostream &out, const vector<SweepRun> &runs, const vector<RunMetrics> &results) {
+    out << "trace,policy,quantum,levels,aging,cpus,affinity,migration_cost,"
+           "completed,end_time,throughput,avg_turnaround,p99_turnaround,avg_waiting,context_switches,"
+           "with_deadline,deadlines_missed,utilization,steals,migrations,instructions\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+        const SimulatorConfig &config = runs[i].config;
+        const RunMetrics &metrics = results[i];
+        out << csvField(runs[i].traceName) << ',' << csvField(config.policyName) << ','
+            << config.options.quantum << ',' << config.options.mlfqLevels << ',' << config.options.agingInterval << ','
+            << config.cpus << ',' << config.pinned << ',' << config.migrationCost << ','
+            << metrics.completed << ',' << metrics.endTime << ',' << metrics.throughput << ','
+            << metrics.avgTurnaround << ',' << metrics.p99Turnaround << ',' << metrics.avgWaiting << ','
+            << metrics.contextSwitches << ',' << metrics.withDeadline << ',' << metrics.deadlinesMissed << ','
+            << metrics.utilization << ',' << metrics.steals << ',' << metrics.migrations << ',' << metrics.instructions << '\n';
+    }
+}
+
+bool runSweep(const SweepOptions &sweep, const SimulatorConfig &base, const Trace* baseTrace,
+              const string &baseTraceName) {
+    map<string, unique_ptr<Trace>> traces;
+    vector<SweepRun> runs;
+    if (!readSweep(sweep, {baseTraceName, baseTrace, base}, runs, traces))
+        return false;
+    ofstream out(sweep.csvFile);
+    if (!out) {
+        cerr << "Error: Could not create " << sweep.csvFile << endl;
+        return false;
+    }
+
+    // Each worker takes the next run not yet started until there are none
+    // left. Runs share nothing but the read-only traces.
+    int jobs = sweep.jobs > 0 ? sweep.jobs : max(1u, thread::hardware_concurrency());
+    jobs = min<size_t>(jobs, max<size_t>(runs.size(), 1));
+    vector<RunMetrics> results(runs.size());
+    atomic<size_t> nextRun(0);
+    auto worker = [&] {
+        for (size_t i = nextRun++; i < runs.size(); i = nextRun++) {
+            Simulator simulator(*runs[i].trace);
+            simulator.open(runs[i].config, LogSinks{false, "", ""});
+            results[i] = simulator.run();
+        }
+    };
+    vector<thread> pool;
+    for (int i = 0; i < jobs; i++)
+        pool.emplace_back(worker);
+    for (thread &worker : pool)
+        worker.join();
+
+    // Rows are in sweep file order however the runs finished
+    writeCsv(out, runs, results);
+    out.close();
+    if (!out) {
+        cerr << "Error: Could not write " << sweep.csvFile << endl;
+        return false;
+    }
+    cout << "Ran " << runs.size() << " configurations on " << jobs << " threads, results in "
+         << sweep.csvFile << endl;
+    return true;
+}
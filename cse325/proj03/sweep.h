@@ -0,0 +1,34 @@
+#pragma once
+
+#include "simulator.h"
+#include "trace.h"
+
+#include <string>
+
+// A parameter sweep (--sweep): many independent runs, one Simulator each,
+// spread over a pool of threads, with one CSV row of metrics per run. The
+// wall-clock time of each run is left out so the CSV is repeatable.
+//
+// Each line of the sweep file is one or more key=value settings, where a
+// value may be a comma-separated list. A line stands for every combination of
+// its lists, the first key varying slowest. Keys are the command-line options
+// without their dashes (policy, quantum, levels, aging, cpus, migration-cost),
+// affinity=0|1, and trace=<binary trace file>. Keys a line leaves out keep
+// their command-line value. Blank lines and lines starting with # are skipped.
+//
+//   policy=priority,rr,cfs quantum=2,5,10
+//   trace=small.trace,big.trace policy=mlfq cpus=1,4 aging=0,50
+struct SweepOptions {
+    std::string file;               // The sweep file
+    std::string csvFile = "sweep.csv";
+    int jobs = 0;                   // Threads, 0 for one per hardware thread
+};
+
+// Runs the sweep. base holds the command-line settings. baseTrace is the
+// command-line workload, used by lines without trace=, and is named
+// baseTraceName in the CSV. It may be null if every line names a trace.
+// Returns false, with a message on stderr, on a bad sweep file, an unreadable
+// trace, or a CSV file that cannot be written. Nothing runs unless every line
+// is valid.
+bool runSweep(const SweepOptions &sweep, const SimulatorConfig &base, const Trace* baseTrace,
+              const std::string &baseTraceName);
@@ -0,0 +1,275 @@
+#include "trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char TRACE_MAGIC[8] = {'P', '0', '3', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t processCount;
+    uint64_t textCount;
+    uint64_t wordCount;
+    uint64_t textBytes;
+};
+
+Trace::~Trace() {
+    if (mapping)
+        munmap(mapping, mappingSize);
+}
+
+// Works out what one line of a process file does, the same way the simulator
+// has always read it when executing. Returns false if a NETWORK or I/O call
+// has no usable duration.
+static bool compileInstruction(const string &line, Op &op, int &duration) {
+    if (line.find("SYS_CALL") == string::npos) {
+        op = OP_NORMAL;
+        return true;
+    }
+    op = OP_SYSCALL;
+    size_t commaPos = line.find(',');
+    if (commaPos == string::npos)
+        return true;
+    string callDetail = line.substr(commaPos + 1);
+    // Trim leading whitespace.
+    callDetail.erase(0, callDetail.find_first_not_of(" \t"));
+    stringstream ss(callDetail);
+    string type;
+    ss >> type;
+    if (type == "NETWORK" || type == "I/O") {
+        string param;
+        ss >> param;
+        try {
+            duration = stoi(param);
+        } catch (const exception &) {
+            return false;
+        }
+        // A binary trace cannot hold a negative duration, see loadBinary()
+        if (duration < 0)
+            return false;
+        op = type == "NETWORK" ? OP_NETWORK : OP_IO;
+    }
+    else if (type == "TERMINATE") {
+        op = OP_TERMINATE;
+    }
+    else if (type == "ERROR") {
+        op = OP_ERROR;
+    }
+    return true;
+}
+
+void Trace::addProcess(int pid, int priority, int deadline) {
+    if (ownedOffsets.empty())
+        ownedOffsets.assign(1, 0);
+    // The previous process ends where this one starts
+    if (!processList.empty())
+        processList.back().wordCount = ownedWords.size() - processList.back().firstWord;
+    processList.push_back({pid, priority, deadline, 0, ownedWords.size(), 0});
+}
+
+bool Trace::addInstruction(const string &line, const string &source) {
+    Op op;
+    int duration = 0;
+    if (!compileInstruction(line, op, duration)) {
+        cerr << "Error: Bad duration in " << source << ": " << line << endl;
+        return false;
+    }
+    auto found = textIndex.find(line);
+    uint32_t index;
+    if (found != textIndex.end()) {
+        index = found->second;
+    } else {
+        if (textIndex.size() == MAX_TEXTS) {
+            cerr << "Error: More than " << MAX_TEXTS << " distinct instructions" << endl;
+            return false;
+        }
+        index = textIndex.size();
+        textIndex.emplace(line, index);
+        ownedText += line;
+        ownedOffsets.push_back(ownedText.size());
+    }
+    ownedWords.push_back((uint32_t)op << TEXT_BITS | index);
+    if (hasDuration(op))
+        ownedWords.push_back((uint32_t)duration);
+    return true;
+}
+
+void Trace::finish() {
+    if (ownedOffsets.empty())
+        ownedOffsets.assign(1, 0);
+    if (!processList.empty())
+        processList.back().wordCount = ownedWords.size() - processList.back().firstWord;
+    // Only needed while building
+    unordered_map<string, uint32_t>().swap(textIndex);
+    wordData = ownedWords.data();
+    wordTotal = ownedWords.size();
+    textOffsets = ownedOffsets.data();
+    textCount = ownedOffsets.size() - 1;
+    textBytes = ownedText.data();
+}
+
+bool Trace::loadText(int numProcesses) {
+    for (int i = 1; i <= numProcesses; i++) {
+        string filename = "process" + to_string(i);
+        ifstream file(filename);
+        if (!file) {
+            cerr << "Error: Could not open " << filename << endl;
+            continue;
+        }
+        int priority;
+        file >> priority;
+        string line;
+        getline(file, line); // consume the rest of the line after priority,
+        // which may hold a deadline for EDF
+        int deadline = NO_DEADLINE;
+        istringstream rest(line);
+        int value;
+        if (rest >> value)
+            deadline = value;
+        addProcess(i, priority, deadline);
+        while (getline(file, line)) {
+            if (line.empty())
+                continue;
+            if (!addInstruction(line, filename))
+                return false;
+        }
+    }
+    finish();
+    return true;
+}
+
+bool Trace::loadBinary(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        cerr << "Error: Could not open " << path << endl;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(TraceHeader)) {
+        cerr << "Error: " << path << " is not a proj03 trace" << endl;
+        close(fd);
+        return false;
+    }
+    mappingSize = fileStat.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        cerr << "Error: Could not map " << path << endl;
+        return false;
+    }
+
+    const char* base = (const char*)mapping;
+    const TraceHeader* header = (const TraceHeader*)base;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION) {
+        cerr << "Error: " << path << " is not a proj03 trace" << endl;
+        return false;
+    }
+    // Sizes are checked one part at a time so a corrupt count cannot overflow
+    // the sum. The string table has one offset more than there are strings,
+    // added only once the count is known to fit.
+    size_t remaining = mappingSize - sizeof(TraceHeader);
+    size_t parts[] = {sizeof(TraceProcess), sizeof(uint64_t), sizeof(uint32_t), 1};
+    uint64_t counts[] = {header->processCount, header->textCount, header->wordCount, header->textBytes};
+    uint64_t extra[] = {0, 1, 0, 0};
+    for (int part = 0; part < 4; part++) {
+        size_t fits = remaining / parts[part];
+        if (fits < extra[part] || counts[part] > fits - extra[part]) {
+            cerr << "Error: " << path << " is truncated" << endl;
+            return false;
+        }
+        remaining -= (counts[part] + extra[part]) * parts[part];
+    }
+    if (remaining != 0) {
+        cerr << "Error: " << path << " has trailing data" << endl;
+        return false;
+    }
+
+    const TraceProcess* processes = (const TraceProcess*)(base + sizeof(TraceHeader));
+    textOffsets = (const uint64_t*)(processes + header->processCount);
+    textCount = header->textCount;
+    wordData = (const uint32_t*)(textOffsets + textCount + 1);
+    wordTotal = header->wordCount;
+    textBytes = (const char*)(wordData + wordTotal);
+
+    if (textOffsets[0] != 0 || textOffsets[textCount] != header->textBytes) {
+        cerr << "Error: " << path << " has a bad string table" << endl;
+        return false;
+    }
+    for (size_t index = 0; index < textCount; index++) {
+        if (textOffsets[index] > textOffsets[index + 1]) {
+            cerr << "Error: " << path << " has a bad string table" << endl;
+            return false;
+        }
+    }
+    // Walk every record once, so the simulation never has to check them.
+    // A duration has to fit the int the text loader would have parsed it into.
+    processList.assign(processes, processes + header->processCount);
+    for (const TraceProcess &process : processList) {
+        if (process.pid <= 0) {
+            cerr << "Error: " << path << " has a process with PID " << process.pid << endl;
+            return false;
+        }
+        if (process.firstWord > wordTotal || process.wordCount > wordTotal - process.firstWord) {
+            cerr << "Error: " << path << " has a bad record range for process " << process.pid << endl;
+            return false;
+        }
+        const uint32_t* end = wordData + process.firstWord + process.wordCount;
+        for (const uint32_t* cursor = wordData + process.firstWord; cursor < end; cursor++) {
+            Op op = (Op)(*cursor >> TEXT_BITS);
+            if (op > OP_SYSCALL || (*cursor & (MAX_TEXTS - 1)) >= textCount || (hasDuration(op) && ++cursor == end)
+                || (hasDuration(op) && *cursor > (uint32_t)INT32_MAX)) {
+                cerr << "Error: " << path << " has a bad record in process " << process.pid << endl;
+                return false;
+            }
+        }
+    }
+    vector<int32_t> pids(processList.size());
+    for (size_t index = 0; index < processList.size(); index++)
+        pids[index] = processList[index].pid;
+    sort(pids.begin(), pids.end());
+    auto duplicate = adjacent_find(pids.begin(), pids.end());
+    if (duplicate != pids.end()) {
+        cerr << "Error: " << path << " has more than one process with PID " << *duplicate << endl;
+        return false;
+    }
+    return true;
+}
+
+bool Trace::save(const string &path) const {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Error: Could not create " << path << endl;
+        return false;
+    }
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.processCount = processList.size();
+    header.textCount = textCount;
+    header.wordCount = wordTotal;
+    header.textBytes = textOffsets[textCount];
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)processList.data(), processList.size() * sizeof(TraceProcess));
+    out.write((const char*)textOffsets, (textCount + 1) * sizeof(uint64_t));
+    out.write((const char*)wordData, wordTotal * sizeof(uint32_t));
+    out.write(textBytes, header.textBytes);
+    out.close();
+    if (!out) {
+        cerr << "Error: Could not write " << path << endl;
+        return false;
+    }
+    return true;
+}
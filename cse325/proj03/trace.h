@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+// Pre-parsed instructions. Each one is a 32-bit record: the operation in the
+// top 8 bits and the index of its text in the string table in the low 24.
+// NETWORK and I/O calls are followed by a second 32-bit word, the duration.
+// The text is kept so the log can show it exactly as the process file had it.
+enum Op : uint8_t {
+    OP_NORMAL,      // Logged as "Process N: <text>", takes one time unit
+    OP_NETWORK,     // SYS_CALL, NETWORK <duration>
+    OP_IO,          // SYS_CALL, I/O <duration>
+    OP_TERMINATE,   // SYS_CALL, TERMINATE
+    OP_ERROR,       // SYS_CALL, ERROR
+    OP_SYSCALL      // Any other SYS_CALL: logged, takes no time
+};
+
+// Deadline of a process whose file gives none (EDF runs those last)
+const int32_t NO_DEADLINE = INT32_MAX;
+
+const uint32_t TEXT_BITS = 24;
+const uint32_t MAX_TEXTS = 1u << TEXT_BITS;
+
+struct Instruction {
+    Op op;
+    uint32_t text;      // String table index
+    int duration;       // NETWORK and I/O only
+};
+
+inline bool hasDuration(Op op) { return op == OP_NETWORK || op == OP_IO; }
+
+// A process as loaded: its instructions are words [firstWord, firstWord + wordCount)
+// of the trace
+struct TraceProcess {
+    int32_t pid;
+    int32_t priority;
+    int32_t deadline;
+    uint32_t reserved;
+    uint64_t firstWord;
+    uint64_t wordCount;
+};
+
+// All the processes of a run and their instructions, in one flat array of
+// records plus one string table. Built from the text process files, or
+// mapped straight from a binary trace file written by save().
+//
+// Binary trace layout (native byte order, every part naturally aligned):
+//   header         magic "P03TRACE", version, counts and sizes
+//   processes      TraceProcess[processCount]
+//   text offsets   uint64_t[textCount + 1], start of each text in the text bytes
+//   records        uint32_t[wordCount]
+//   text bytes     char[textBytes], texts back to back without terminators
+class Trace {
+public:
+    Trace() {}
+    ~Trace();
+    Trace(const Trace &) = delete;
+    Trace &operator=(const Trace &) = delete;
+
+    // Parses process1..processN in the current directory. Missing files are
+    // reported and skipped, like they always were. Returns false on an
+    // instruction it cannot compile (a NETWORK or I/O call without a duration).
+    bool loadText(int numProcesses);
+    // Maps a file written by save(). Returns false, with a message on stderr,
+    // if it is not a valid trace: besides the layout, PIDs must be positive
+    // and unique and no NETWORK or I/O duration may exceed INT32_MAX.
+    bool loadBinary(const std::string &path);
+    bool save(const std::string &path) const;
+
+    // Builds a trace in memory, as loadText() does from the files: begin
+    // each process with addProcess(), add its instruction lines in order,
+    // then finish() once all processes are in. addInstruction() returns
+    // false, with a message on stderr naming source, on a line it cannot compile.
+    void addProcess(int pid, int priority, int deadline);
+    bool addInstruction(const std::string &line, const std::string &source);
+    void finish();
+
+    const std::vector<TraceProcess> &processes() const { return processList; }
+    const uint32_t* words() const { return wordData; }
+    size_t wordCount() const { return wordTotal; }
+    std::string_view text(uint32_t index) const {
+        return std::string_view(textBytes + textOffsets[index], textOffsets[index + 1] - textOffsets[index]);
+    }
+
+    // Decodes the record at *cursor and moves the cursor past it.
+    static Instruction decode(const uint32_t* &cursor) {
+        uint32_t word = *cursor++;
+        Instruction instruction{(Op)(word >> TEXT_BITS), word & (MAX_TEXTS - 1), 0};
+        if (hasDuration(instruction.op))
+            instruction.duration = (int32_t)*cursor++;
+        return instruction;
+    }
+
+private:
+    std::vector<TraceProcess> processList;
+    const uint32_t* wordData = nullptr;
+    size_t wordTotal = 0;
+    const uint64_t* textOffsets = nullptr;
+    size_t textCount = 0;
+    const char* textBytes = nullptr;
+
+    // Storage for a trace compiled from text
+    std::vector<uint32_t> ownedWords;
+    std::vector<uint64_t> ownedOffsets;
+    std::string ownedText;
+    // Each distinct instruction text is stored once, this finds it while building
+    std::unordered_map<std::string, uint32_t> textIndex;
+
+    // Mapping of a binary trace
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
@@ -0,0 +1,224 @@
+// Synthetic workload generator for proj03. Writes a seeded, repeatable mix
+// of CPU-bound and I/O-bound processes, as a binary trace for --trace or as
+// process1..processN files.
+//
+// Every process is a run of CPU bursts, normal instructions, with a NETWORK
+// or I/O call between each two, and ends with SYS_CALL, TERMINATE. CPU-bound
+// processes have long bursts, I/O-bound ones bursts an eighth as long.
+// Burst lengths are exponentially distributed around their mean, blocking
+// times uniform from 1 to twice theirs.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+
+#include "trace.h"
+
+using namespace std;
+
+const char* USAGE = "Usage: ./workload <trace_file> [--processes <n>] [--seed <n>] [--io-percent <n>] [--bursts <n>]\n"
+                    "                  [--burst <n>] [--io-time <n>] [--priority uniform|skewed|equal]\n"
+                    "                  [--max-priority <n>] [--deadline-percent <n>]\n"
+                    "       ./workload --text [options]    (writes process1..processN here)";
+
+// Normal instructions are drawn from these
+const char* const NORMAL_TEXTS[] = {"COMPUTE", "ADD R1 R2", "LOAD X", "STORE Y", "MUL"};
+
+struct WorkloadOptions {
+    long long processes = 1000;
+    long long seed = 1;
+    long long ioPercent = 30;       // Share of processes that are I/O-bound
+    long long bursts = 4;           // CPU bursts per process
+    long long burst = 20;           // Mean CPU burst of a CPU-bound process, in instructions
+    long long ioTime = 30;          // Mean NETWORK or I/O duration
+    string priority = "uniform";    // uniform: 1..max equally likely, skewed: each level half as likely as
+                                    // the one below, equal: all max
+    long long maxPriority = 10;
+    long long deadlinePercent = 0;  // Share of processes with an EDF deadline
+};
+
+// The standard fixes mt19937_64's output but not the distributions', so they
+// are done here to give the same workload for a seed on every platform.
+class Random {
+private:
+    mt19937_64 engine;
+
+public:
+    explicit Random(uint64_t seed) : engine(seed) {}
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) { return engine() % n; }
+    // Uniform in [0, 1)
+    double fraction() { return (engine() >> 11) * (1.0 / 9007199254740992.0); }
+    bool percent(long long chance) { return (long long)below(100) < chance; }
+    // Exponential with this mean, at least 1 and at most 100 times the mean
+    long long around(long long mean) {
+        double value = 1 + floor(-(mean - 0.5) * log(1 - fraction()));
+        return min((long long)value, mean * 100);
+    }
+};
+
+// One process: its first line and its instruction lines
+struct GeneratedProcess {
+    int priority;
+    int deadline;
+    vector<string> lines;
+};
+
+static void generateProcess(Random &random, const WorkloadOptions &options, long long meanLength,
+                            GeneratedProcess &process) {
+    switch (options.priority[0]) {
+    case 'u':
+        process.priority = 1 + random.below(options.maxPriority);
+        break;
+    case 's':
+        process.priority = 1;
+        while (process.priority < options.maxPriority && random.below(2))
+            process.priority++;
+        break;
+    default:
+        process.priority = options.maxPriority;
+    }
+    bool ioBound = random.percent(options.ioPercent);
+    long long burst = ioBound ? max(1LL, options.burst / 8) : options.burst;
+
+    process.lines.clear();
+    for (long long i = 0; i < options.bursts; i++) {
+        if (i > 0) {
+            long long duration = 1 + random.below(2 * options.ioTime);
+            process.lines.push_back((random.below(2) ? "SYS_CALL, NETWORK " : "SYS_CALL, I/O ")
+                                    + to_string(duration));
+        }
+        for (long long length = random.around(burst); length > 0; length--)
+            process.lines.push_back(NORMAL_TEXTS[random.below(sizeof(NORMAL_TEXTS) / sizeof(NORMAL_TEXTS[0]))]);
+    }
+    process.lines.push_back("SYS_CALL, TERMINATE");
+
+    // A deadline somewhere between its own length and the time the whole
+    // workload would take on one CPU, so some are met and some are not
+    process.deadline = NO_DEADLINE;
+    if (random.percent(options.deadlinePercent)) {
+        // Unsigned: at the option limits the span is about 1e19, past a long long
+        uint64_t deadline = process.lines.size() + random.below((uint64_t)options.processes * meanLength);
+        process.deadline = min(deadline, (uint64_t)NO_DEADLINE - 1);
+    }
+}
+
+// Parses a count, which may end in K or M for thousands or millions
+static bool parseCount(const string &text, long long &value) {
+    size_t digits = 0;
+    while (digits < text.size() && isdigit((unsigned char)text[digits]))
+        digits++;
+    if (digits == 0 || digits > 9)
+        return false;
+    string suffix = text.substr(digits);
+    long long scale = suffix.empty() ? 1 : suffix == "K" ? 1000 : suffix == "M" ? 1000000 : 0;
+    if (scale == 0)
+        return false;
+    value = stoll(text.substr(0, digits)) * scale;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << USAGE << endl;
+        return 1;
+    }
+    string output = argv[1];
+    bool text = output == "--text";
+    // An option where the trace file should be, as in "./workload --processes 10"
+    if (!text && output[0] == '-') {
+        cerr << "Error: Expected a trace file or --text before '" << output << "'" << endl;
+        cerr << USAGE << endl;
+        return 1;
+    }
+    WorkloadOptions options;
+    // Options taking a number, and the range each accepts
+    struct NumberOption { const char* name; long long* value; long long minimum; long long maximum; };
+    const NumberOption numberOptions[] = {
+        {"--processes", &options.processes, 1, 10000000},
+        {"--seed", &options.seed, 0, 999999999},
+        {"--io-percent", &options.ioPercent, 0, 100},
+        {"--bursts", &options.bursts, 1, 1000000},
+        {"--burst", &options.burst, 1, 1000000},
+        {"--io-time", &options.ioTime, 1, 1000000},
+        {"--max-priority", &options.maxPriority, 1, 1000},
+        {"--deadline-percent", &options.deadlinePercent, 0, 100},
+    };
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        const NumberOption* numberOption = nullptr;
+        for (const NumberOption &candidate : numberOptions) {
+            if (option == candidate.name)
+                numberOption = &candidate;
+        }
+        if (option == "--priority" && i + 1 < argc) {
+            options.priority = argv[++i];
+            if (options.priority != "uniform" && options.priority != "skewed" && options.priority != "equal") {
+                cerr << "Error: --priority must be uniform, skewed or equal" << endl;
+                return 1;
+            }
+        }
+        else if (numberOption && i + 1 < argc) {
+            long long value;
+            if (!parseCount(argv[++i], value) || value < numberOption->minimum || value > numberOption->maximum) {
+                cerr << "Error: " << option << " needs a number from " << numberOption->minimum << " to "
+                     << numberOption->maximum << endl;
+                return 1;
+            }
+            *numberOption->value = value;
+        }
+        else {
+            cerr << "Error: Unknown option '" << option << "'" << endl;
+            cerr << USAGE << endl;
+            return 1;
+        }
+    }
+
+    // Roughly the average process length, for placing deadlines
+    long long meanBurst = (options.burst * (100 - options.ioPercent)
+                           + max(1LL, options.burst / 8) * options.ioPercent) / 100;
+    long long meanLength = max(1LL, options.bursts * (meanBurst + 1));
+
+    Random random(options.seed);
+    Trace trace;
+    GeneratedProcess process;
+    long long instructions = 0;
+    for (long long pid = 1; pid <= options.processes; pid++) {
+        generateProcess(random, options, meanLength, process);
+        instructions += process.lines.size();
+        if (text) {
+            ofstream file("process" + to_string(pid));
+            if (!file) {
+                cerr << "Error: Could not create process" << pid << endl;
+                return 1;
+            }
+            file << process.priority;
+            if (process.deadline != NO_DEADLINE)
+                file << ' ' << process.deadline;
+            file << '\n';
+            for (const string &line : process.lines)
+                file << line << '\n';
+            continue;
+        }
+        trace.addProcess(pid, process.priority, process.deadline);
+        string source = "generated process " + to_string(pid);
+        for (const string &line : process.lines) {
+            if (!trace.addInstruction(line, source))
+                return 1;
+        }
+    }
+    if (text) {
+        cout << "Wrote process1..process" << options.processes << " (" << instructions << " instructions)" << endl;
+        return 0;
+    }
+    trace.finish();
+    if (!trace.save(output))
+        return 1;
+    cout << "Wrote " << options.processes << " processes (" << instructions << " instructions) to " << output << endl;
+    return 0;
+}
@@ -5,6 +5,13 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -43,6 +50,21 @@ struct Order {
 map<unsigned int, InventoryItem> inventory;     // Stores inventory data
 vector<Order> orders;                           // Stores orders data
 
+// Transaction log: opened once, lines are collected in logBuffer and written in one go,
+// once LOG_FLUSH_BYTES are buffered or by the flusher thread every logFlushMillis
+const size_t LOG_FLUSH_BYTES = 1 << 16;
+const int MAX_FLUSH_MILLIS = 10000;             // Longest -f
+int logFlushMillis = 100;                       // -f, 0 writes every line at once
+bool logSync = false;                           // -s, fdatasync after each write: one sync for a whole group of lines
+int logFD = -1;                                 // "log", -1 if it could not be opened
+string logBuffer;                               // Lines not yet written, guarded by logMutex
+bool logFailed = false;                         // A write or sync failed and was reported
+pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t flusherWake = PTHREAD_COND_INITIALIZER;
+pthread_t flusherThread;
+bool flushing = false;                          // The flusher thread is running
+bool logClosing = false;                        // Tells the flusher to stop
+
 
 // Function to open inventory.old, extract values, store the values in inventory map, close file
 void LoadInventory() {
@@ -90,23 +112,142 @@ void SaveInventory() {
 }
 
 
-// Save transactions into file "log"
-void LogTransaction(unsigned int customerID, unsigned int productID, string productDescription, unsigned int quantity, double transactionAmount, bool result) {
-    ofstream logFile("log", ios::app);
+// Write the buffered lines to "log" (and sync them with -s). The caller holds logMutex.
+void FlushLog() {
+    if (logFD == -1 || logBuffer.empty()) {
+        return;
+    }
+    const char* data = logBuffer.data();
+    size_t left = logBuffer.size();
+    bool written = true;
+    while (left > 0) {
+        ssize_t count = write(logFD, data, left);
+        if (count == -1 && errno == EINTR) {
+            continue;   // Interrupted before writing anything, try again
+        }
+        if (count == -1) {
+            written = false;
+            break;
+        }
+        data += count;
+        left -= count;
+    }
+    if (written && logSync) {
+        written = fdatasync(logFD) == 0;
+    }
+    // Report the first failure only, not one per flush
+    if (!written && !logFailed) {
+        cerr << "Error: Could not write log file." << endl;
+        logFailed = true;
+    }
+    logBuffer.clear();
+}
+
+
+// The flusher thread function: writes out the buffered log lines every
+// logFlushMillis, so they reach the file even when no more orders come
+void* FlusherFunction(void*) {
+    pthread_mutex_lock(&logMutex);
+    while (!logClosing) {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long nanoseconds = deadline.tv_nsec + logFlushMillis * 1000000L;
+        deadline.tv_sec += nanoseconds / 1000000000L;
+        deadline.tv_nsec = nanoseconds % 1000000000L;
+        pthread_cond_timedwait(&flusherWake, &logMutex, &deadline);
+        FlushLog();
+    }
+    pthread_mutex_unlock(&logMutex);
+    pthread_exit(NULL);
+}
+
+
+// Stop the flusher, write out what is left and close "log"
+void CloseLog() {
+    if (flushing) {
+        pthread_mutex_lock(&logMutex);
+        logClosing = true;
+        pthread_cond_signal(&flusherWake);
+        pthread_mutex_unlock(&logMutex);
+        pthread_join(flusherThread, NULL);
+        flushing = false;
+    }
+    if (logFD != -1) {
+        FlushLog();
+        close(logFD);
+        logFD = -1;
+    }
+}
+
+
+// Open "log" for appending, once for the whole run, and start flushing it on time
+void OpenLog() {
+    logFD = open("log", O_WRONLY | O_CREAT | O_APPEND, 0644);
     // Ensure "log" was successfully opened / created
-    if (!logFile) {
+    if (logFD == -1) {
         cerr << "Error: Could not create log file." << endl;
         return;
     }
-    
-    logFile << right << setfill('0') << setw(7) << customerID << " "  // 7-digit customer ID
-            << setw(6) << productID << " "                           // 6-digit product ID
-            << left << setfill(' ') << setw(30) << productDescription << " "  // 30-character description, left-aligned
-            << right << setw(5) << quantity << "  "                  // 5-digit quantity, right-aligned
-            << left << "$" << setw(9) << fixed << setprecision(2) << transactionAmount << " "  // Money field
-            << (result ? "filled" : "rejected") << endl;
-
-    logFile.close();
+    logBuffer.reserve(LOG_FLUSH_BYTES + 512);
+    if (logFlushMillis > 0) {
+        flushing = pthread_create(&flusherThread, NULL, FlusherFunction, NULL) == 0;
+    }
+}
+
+
+// Append value to line, right-aligned in width characters padded with fill (what setw/setfill did)
+void AppendNumber(string& line, unsigned int value, size_t width, char fill) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    if (count < width) {
+        line.append(width - count, fill);
+    }
+    while (count > 0) {
+        line += digits[--count];
+    }
+}
+
+
+// Append text to line, left-aligned in width characters padded with spaces
+void AppendText(string& line, const char* text, size_t length, size_t width) {
+    line.append(text, length);
+    if (length < width) {
+        line.append(width - length, ' ');
+    }
+}
+
+
+// Save transactions into file "log". Lines are buffered (see FlushLog), formatted by hand exactly as the
+// iostream manipulators did
+void LogTransaction(unsigned int customerID, unsigned int productID, const string& productDescription, unsigned int quantity, double transactionAmount, bool result) {
+    if (logFD == -1) {
+        return;
+    }
+
+    char money[400];    // Wide enough for any double
+    int moneyLength = snprintf(money, sizeof(money), "%.2f", transactionAmount);   // Same rounding as fixed/setprecision(2)
+
+    pthread_mutex_lock(&logMutex);
+    AppendNumber(logBuffer, customerID, 7, '0');                            // 7-digit customer ID
+    logBuffer += ' ';
+    AppendNumber(logBuffer, productID, 6, '0');                             // 6-digit product ID
+    logBuffer += ' ';
+    AppendText(logBuffer, productDescription.data(), productDescription.size(), 30);  // 30-character description, left-aligned
+    logBuffer += ' ';
+    AppendNumber(logBuffer, quantity, 5, ' ');                              // 5-digit quantity, right-aligned
+    logBuffer += "  $";
+    AppendText(logBuffer, money, moneyLength, 9);                           // Money field
+    logBuffer += result ? " filled\n" : " rejected\n";
+
+    // Flush by size here, by time in the flusher thread
+    if (logBuffer.size() >= LOG_FLUSH_BYTES || logFlushMillis == 0) {
+        FlushLog();
+    }
+    pthread_mutex_unlock(&logMutex);
 }
 
 
@@ -168,9 +309,32 @@ void* ConsumerFunction(void* arg) {
 }
 
 
-int main ()  {
+// Parse the log options: -f <ms> (flush interval, 0 writes every line) and -s (sync each write)
+void ParseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            logFlushMillis = atoi(argv[i+1]);
+            i++;  // Skip the next argument
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            logSync = true;
+        }
+    }
+
+    if (logFlushMillis < 0 || logFlushMillis > MAX_FLUSH_MILLIS) {
+        cerr << "Error: Invalid flush interval. Must be between 0 and " << MAX_FLUSH_MILLIS << " ms." << endl;
+        exit(1);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse the log options
+    ParseArguments(argc, argv);
     // Load the inventory
     LoadInventory();
+    // Open the transaction log
+    OpenLog();
 
     // Create producer and consumer threads
     pthread_t  producerThread, consumerThread;
@@ -183,6 +347,8 @@ int main ()  {
     void* consumerStatus = NULL;
     pthread_create(&consumerThread, NULL, ConsumerFunction, NULL);
     pthread_join(consumerThread, &consumerStatus);     // wait for consumer and get status
+    // Write out the lines logged so far, also when the consumer stopped on an error
+    CloseLog();
 
     // Check if consumer thread ended with error
     if (consumerStatus != NULL) {
@@ -3,10 +3,15 @@
 #include <fstream>
 #include <pthread.h>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <semaphore.h>
 #include <cstring>
+#include <ctime>
+
+#include "ring.h"
+#include "transactionlog.h"
 
 using namespace std;
 
@@ -29,29 +34,94 @@ struct Order {
 };
 
 
+// The result of one order, as it goes in the log
+struct Transaction {
+    unsigned int customerID;
+    unsigned int productID;
+    string description;
+    unsigned int quantity;
+    double amount;
+    bool result;
+};
+
+
+// One shard of the inventory. Each product belongs to one shard, so
+// consumers working on different shards never wait for each other. Orders
+// for a shard are decided strictly in the order consumers took them from the
+// buffer: each gets the shard's next ticket when it is taken, and waits until
+// serving reaches it. Every product therefore sees the same sequence of
+// orders, and the same decisions, as with a single consumer.
+struct alignas(64) InventoryShard {
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t turn = PTHREAD_COND_INITIALIZER;     // Signalled when serving moves on
+    unsigned long nextTicket = 0;                       // Handed out under the buffer mutex
+    unsigned long serving = 0;                          // Ticket of the order to decide next
+    unordered_map<unsigned int, InventoryItem> items;
+};
+
+
 // Global variables
-map<unsigned int, InventoryItem> inventory;  // Stores inventory data
-const int MAX_BUFFER_SIZE = 30;             // Maximum buffer size
+const int INVENTORY_SHARDS = 64;            // Power of two
+InventoryShard inventory[INVENTORY_SHARDS]; // Stores inventory data
+const int MAX_BUFFER_SIZE = 65536;          // Maximum buffer size
+const int LOCKFREE_BUFFER_SIZE = 4096;      // Default buffer size with -q lockfree
 const int MAX_PRODUCERS = 9;                // Maximum number of producers
+const int MAX_CONSUMERS = 16;               // Maximum number of consumers
+const int ADAPTIVE_BATCH_LIMIT = 256;       // Largest batch with -k auto
+const int MAX_FLUSH_MILLIS = 10000;         // Longest -f
+
+// Which bounded buffer carries the orders (-q)
+enum QueueType { SEMAPHORE_QUEUE, LOCKFREE_QUEUE };
+QueueType queueType;
 
 // Bounded buffer variables
-Order* buffer;                              // Circular buffer for orders
+Order* buffer;                              // Circular buffer for orders (-q sem)
+BoundedRing<Order>* ring = NULL;            // Lock-free ring for orders (-q lockfree)
 int bufferSize;                             // Actual buffer size (from args)
 int in = 0;                                 // Producer inserts at this index
 int out = 0;                                // Consumer removes from this index
 int count = 0;                              // Number of items in buffer
 int numProducers;                           // Number of producer threads
+int numConsumers;                           // Number of consumer threads
+int batchSize;                              // Orders a producer publishes at once (-k)
+bool adaptiveBatch;                         // -k auto: batchSize is the most, adjusted as it runs
+int producersFinished = 0;                  // End markers taken from the buffer
+unsigned long nextSequence = 0;             // Arrival order of the next order taken from the buffer
 
 // Semaphores for synchronization
 sem_t emptySlots;                           // Counts empty buffer slots
 sem_t full;                                 // Counts filled buffer slots
 sem_t mutex;                                // Controls access to buffer
 
+// Producers reserving several slots on the semaphores take turns, so two
+// half-reserved batches cannot hold every slot between them
+pthread_mutex_t producerLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The ring only has room for one thread taking orders at a time. With
+// several consumers they take turns, and the ring's order and the tickets
+// handed out stay the same.
+pthread_mutex_t consumerLock = PTHREAD_MUTEX_INITIALIZER;
+
 // Global variables for error handling
 pthread_mutex_t errorMutex = PTHREAD_MUTEX_INITIALIZER;
 bool hasError = false;
 string errorMessage;
 
+// Log lines are written in arrival order. A consumer that decides an order
+// before an earlier one is logged leaves its line here.
+pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned long nextLogged = 0;                   // Arrival order of the next line to write
+map<unsigned long, Transaction> pendingLog;     // Decided, waiting for earlier orders
+
+// The log stays open for the run and is written in large chunks. The flusher
+// thread writes out what is buffered every flushMillis, so lines reach the
+// file soon after their orders are decided even when orders stop coming.
+TransactionLog transactionLog;                  // Guarded by logMutex
+LogPolicy logPolicy;                            // -s syncs each write
+int flushMillis;                                // -f, 0 writes every line at once
+pthread_cond_t flusherWake = PTHREAD_COND_INITIALIZER;
+bool consumersDone = false;                     // Tells the flusher to stop
+
 // Function to safely report errors
 void reportError(const string& message) {
     pthread_mutex_lock(&errorMutex);
@@ -60,6 +130,12 @@ void reportError(const string& message) {
     pthread_mutex_unlock(&errorMutex);
 }
 
+// The shard a product belongs to. Fibonacci hashing, so runs of consecutive
+// product IDs spread over every shard.
+InventoryShard& ShardFor(unsigned int productID) {
+    return inventory[(productID * 2654435769u) >> 26];
+}
+
 // Function to open inventory.old, extract values, store the values in inventory map
 void LoadInventory() {
     ifstream file("inventory.old");
@@ -76,7 +152,7 @@ void LoadInventory() {
 
     while (file >> id >> price >> stock) {
         getline(file >> ws, desc);
-        inventory[id] = {id, price, stock, desc};
+        ShardFor(id).items[id] = {id, price, stock, desc};
     }
 
     file.close();
@@ -91,34 +167,147 @@ void SaveInventory() {
         return;
     }
 
-    for (const auto& item : inventory) {
-        file << right << setw(6) << item.second.productID << " " 
-             << right << setw(5) << fixed << setprecision(2) << item.second.price << " " 
-             << right << setw(5) << item.second.stock << " " 
-             << item.second.description << endl;
+    // Shards are unordered, the file is sorted by product ID
+    map<unsigned int, const InventoryItem*> sorted;
+    for (const InventoryShard& shard : inventory) {
+        for (const auto& item : shard.items)
+            sorted[item.first] = &item.second;
+    }
+
+    for (const auto& item : sorted) {
+        file << right << setw(6) << item.second->productID << " " 
+             << right << setw(5) << fixed << setprecision(2) << item.second->price << " " 
+             << right << setw(5) << item.second->stock << " " 
+             << item.second->description << endl;
     }
 
     file.close();
 }
 
-// Save transactions into file "log"
-void LogTransaction(unsigned int customerID, unsigned int productID, string productDescription, 
+// Save transactions into file "log". The caller holds logMutex.
+void LogTransaction(unsigned int customerID, unsigned int productID, const string& productDescription, 
     unsigned int quantity, double transactionAmount, bool result) {
-ofstream logFile("log", ios::app);
+    transactionLog.append(customerID, productID, productDescription, quantity, transactionAmount, result);
+    if (flushMillis == 0) {
+        transactionLog.flush();
+    }
+}
+
+// Decide an order against its shard, once every order for the shard that
+// arrived before it has been decided (see InventoryShard).
+Transaction ProcessOrder(const Order& order, InventoryShard& shard, unsigned long ticket) {
+    pthread_mutex_lock(&shard.lock);
+    while (shard.serving != ticket) {
+        pthread_cond_wait(&shard.turn, &shard.lock);
+    }
+
+    // Invalid product ID - log it as rejected with "Invalid Product" description
+    Transaction transaction = {order.customerID, order.productID, "Invalid Product", order.quantity, 0.0, false};
+    auto item = shard.items.find(order.productID);
+    if (item != shard.items.end()) {
+        transaction.description = item->second.description;
+        if (item->second.stock >= order.quantity) {
+            // Order can be fulfilled
+            transaction.amount = order.quantity * item->second.price;
+            transaction.result = true;
+            item->second.stock -= order.quantity;
+        }
+        // Otherwise not enough stock - log it as rejected
+    }
+
+    shard.serving++;
+    pthread_cond_broadcast(&shard.turn);
+    pthread_mutex_unlock(&shard.lock);
+    return transaction;
+}
+
+// Log a decided order, along with any later ones that were only waiting for it.
+void CommitTransaction(unsigned long sequence, const Transaction& transaction) {
+    pthread_mutex_lock(&logMutex);
+    if (sequence != nextLogged) {
+        pendingLog.emplace(sequence, transaction);
+        pthread_mutex_unlock(&logMutex);
+        return;
+    }
+
+    LogTransaction(transaction.customerID, transaction.productID, transaction.description,
+                   transaction.quantity, transaction.amount, transaction.result);
+    nextLogged++;
+    while (!pendingLog.empty() && pendingLog.begin()->first == nextLogged) {
+        const Transaction& next = pendingLog.begin()->second;
+        LogTransaction(next.customerID, next.productID, next.description, next.quantity, next.amount, next.result);
+        pendingLog.erase(pendingLog.begin());
+        nextLogged++;
+    }
+    pthread_mutex_unlock(&logMutex);
+}
 
-if (!logFile) {
-cerr << "Error: Could not create log file." << endl;
-return;
+// The flusher thread function: writes out the buffered log lines every
+// flushMillis until the consumers are done
+void* FlusherFunction(void*) {
+    pthread_mutex_lock(&logMutex);
+    while (!consumersDone) {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long nanoseconds = deadline.tv_nsec + flushMillis * 1000000L;
+        deadline.tv_sec += nanoseconds / 1000000000L;
+        deadline.tv_nsec = nanoseconds % 1000000000L;
+        pthread_cond_timedwait(&flusherWake, &logMutex, &deadline);
+        transactionLog.flush();
+    }
+    pthread_mutex_unlock(&logMutex);
+    pthread_exit(NULL);
 }
 
-logFile << right << setfill('0') << setw(7) << customerID << " "
-<< setw(6) << productID << " "
-<< left << setfill(' ') << setw(30) << productDescription << " "
-<< right << setw(5) << quantity << "  "
-<< left << "$" << setw(9) << fixed << setprecision(2) << transactionAmount << " "
-<< (result ? "filled" : "rejected") << endl;
+// Add a batch of orders and end markers to the buffer, in order, waiting
+// until there is room for all of them. Returns how many orders were already
+// waiting in the buffer.
+size_t InsertOrders(const Order* orders, int n) {
+    if (queueType == LOCKFREE_QUEUE) {
+        return ring->push(orders, n);
+    }
 
-logFile.close();
+    // Wait for n empty slots
+    if (n > 1) {
+        pthread_mutex_lock(&producerLock);
+    }
+    for (int i = 0; i < n; i++) {
+        sem_wait(&emptySlots);
+    }
+    if (n > 1) {
+        pthread_mutex_unlock(&producerLock);
+    }
+    sem_wait(&mutex);   // Enter critical section
+    
+    // Add to buffer
+    size_t waiting = count;
+    for (int i = 0; i < n; i++) {
+        buffer[in] = orders[i];
+        in = (in + 1) % bufferSize;
+    }
+    count += n;
+    
+    sem_post(&mutex);   // Exit critical section
+    for (int i = 0; i < n; i++) {
+        sem_post(&full);    // Signal that a slot is filled
+    }
+    return waiting;
+}
+
+// Publish a producer's staged orders. With -k auto the next batch doubles
+// while the consumers are behind and halves when they had nothing left to
+// do, so under low load each order is handed over as soon as it is read.
+void PublishOrders(vector<Order>& staged, int& limit) {
+    size_t waiting = InsertOrders(staged.data(), staged.size());
+    if (adaptiveBatch) {
+        if (waiting == 0) {
+            limit = max(1, limit / 2);
+        }
+        else if (waiting >= (size_t)limit) {
+            limit = min(batchSize, limit * 2);
+        }
+    }
+    staged.clear();
 }
 
 // The producer thread function
@@ -133,97 +322,137 @@ void* ProducerFunction(void* arg) {
         
         // Still need to insert end marker even on error
         // This ensures the consumer doesn't deadlock
-        sem_wait(&emptySlots);
-        sem_wait(&mutex);
-        
-        buffer[in] = {0, 0, 0, true, producerID}; // End marker
-        in = (in + 1) % bufferSize;
-        count++;
-        
-        sem_post(&mutex);
-        sem_post(&full);
+        Order endMarker = {0, 0, 0, true, producerID};
+        InsertOrders(&endMarker, 1);
         
         pthread_exit((void*)1); // Return error status
     }
 
+    // Orders read but not yet in the buffer
+    vector<Order> staged;
+    staged.reserve(batchSize);
+    int limit = adaptiveBatch ? 1 : batchSize;
+
     // Extract order attributes
     unsigned int customerID, productID, quantity;
     while (file >> customerID >> productID >> quantity) {
         // Create an order
-        Order order = {customerID, productID, quantity, false, producerID};
-        
-        // Add the order to the buffer
-        sem_wait(&emptySlots);   // Wait for an empty slot
-        sem_wait(&mutex);   // Enter critical section
-        
-        // Add to buffer
-        buffer[in] = order;
-        in = (in + 1) % bufferSize;
-        count++;
+        staged.push_back({customerID, productID, quantity, false, producerID});
         
-        sem_post(&mutex);   // Exit critical section
-        sem_post(&full);    // Signal that a slot is filled
+        // Add the batch to the buffer once it is full
+        if ((int)staged.size() >= limit) {
+            PublishOrders(staged, limit);
+        }
     }
 
-    // Insert end marker
-    Order endMarker = {0, 0, 0, true, producerID};
-    
-    sem_wait(&emptySlots);
-    sem_wait(&mutex);
-    
-    buffer[in] = endMarker;
-    in = (in + 1) % bufferSize;
-    count++;
-    
-    sem_post(&mutex);
-    sem_post(&full);
+    // Insert end marker, behind whatever is left
+    staged.push_back({0, 0, 0, true, producerID});
+    PublishOrders(staged, limit);
 
     file.close();
     pthread_exit(NULL); // Success
 }
 
-// The consumer thread function
-void* ConsumerFunction(void* arg) {
-    int producersFinished = 0;
-    
+// Where an order taken from the buffer stands in the arrival order, overall
+// and on its shard
+struct Arrival {
+    unsigned long sequence;
+    InventoryShard* shard;
+    unsigned long ticket;
+};
+
+// The consumer thread function. With -c, several run at once: each takes
+// the next orders from the buffer, decides them on their shards and logs
+// them.
+void* ConsumerFunction(void*) {
+    bool lockFree = queueType == LOCKFREE_QUEUE;
+    bool takeTurns = lockFree && numConsumers > 1;
+    // A lone consumer takes everything waiting. Several take at most a
+    // producer's batch each, so the orders are shared out between them.
+    int limit = numConsumers == 1 ? bufferSize : batchSize;
+    vector<Order> orders(limit);
+    vector<Arrival> arrivals(limit);
+
     // Process orders until all producers are done
-    while (producersFinished < numProducers) {
-        sem_wait(&full);    // Wait for a filled slot
-        sem_wait(&mutex);   // Enter critical section
-        
-        // Get the order from buffer (circular buffer implementation)
-        Order order = buffer[out];
-        out = (out + 1) % bufferSize;  // Move out pointer in circular fashion
-        count--;
-        
-        sem_post(&mutex);   // Exit critical section
-        sem_post(&emptySlots);   // Signal that a slot is now empty
+    while (numProducers > 0) {
+        if (lockFree) {
+            if (takeTurns) {
+                pthread_mutex_lock(&consumerLock);
+            }
+        }
+        else {
+            sem_wait(&full);    // Wait for a filled slot
+            sem_wait(&mutex);   // Enter critical section
+        }
+
+        // Every producer has finished and the buffer is empty: another
+        // consumer took the last end marker, and either woke this one to
+        // stop or let it have the ring after that
+        if (producersFinished == numProducers) {
+            if (takeTurns) {
+                pthread_mutex_unlock(&consumerLock);
+            }
+            else if (!lockFree) {
+                sem_post(&mutex);
+            }
+            break;
+        }
         
-        // Check if this is an end marker
-        if (order.isEndMarker) {
-            producersFinished++;
-            continue;
+        // Get the orders from buffer (circular buffer implementation)
+        int taken;
+        if (lockFree) {
+            taken = ring->pop(orders.data(), limit);    // Waits for an order
+        }
+        else {
+            // One filled slot was waited for, take the others already signalled
+            taken = 0;
+            do {
+                orders[taken++] = buffer[out];
+                out = (out + 1) % bufferSize;  // Move out pointer in circular fashion
+                count--;
+            } while (taken < limit && count > 0 && sem_trywait(&full) == 0);
+        }
+
+        // Their place in the arrival order
+        bool lastMarker = false;
+        for (int i = 0; i < taken; i++) {
+            if (orders[i].isEndMarker) {
+                producersFinished++;
+                lastMarker = producersFinished == numProducers;
+            }
+            else {
+                arrivals[i].sequence = nextSequence++;
+                arrivals[i].shard = &ShardFor(orders[i].productID);
+                arrivals[i].ticket = arrivals[i].shard->nextTicket++;
+            }
         }
         
-        // Process the order
-        auto item = inventory.find(order.productID);
+        if (takeTurns) {
+            pthread_mutex_unlock(&consumerLock);
+        }
+        else if (!lockFree) {
+            sem_post(&mutex);   // Exit critical section
+            for (int i = 0; i < taken; i++) {
+                sem_post(&emptySlots);   // Signal that a slot is now empty
+            }
+        }
         
-        if (item == inventory.end()) {
-            // Invalid product ID - log it as rejected with "Invalid Product" description
-            LogTransaction(order.customerID, order.productID, "Invalid Product", 
-                          order.quantity, 0.0, false);
-        } 
-        else if (item->second.stock >= order.quantity) {
-            // Order can be fulfilled
-            double orderCost = order.quantity * item->second.price;
-            item->second.stock -= order.quantity;
-            LogTransaction(order.customerID, order.productID, item->second.description, 
-                          order.quantity, orderCost, true);
-        } 
-        else {
-            // Not enough stock - log it as rejected
-            LogTransaction(order.customerID, order.productID, item->second.description, 
-                          order.quantity, 0.0, false);
+        // Process the orders, skipping end markers. The last end marker is
+        // the last thing ever put in the buffer, so nothing follows it.
+        for (int i = 0; i < taken; i++) {
+            if (!orders[i].isEndMarker) {
+                CommitTransaction(arrivals[i].sequence, ProcessOrder(orders[i], *arrivals[i].shard, arrivals[i].ticket));
+            }
+        }
+
+        if (lastMarker) {
+            // Wake the consumers still waiting for orders so they can stop.
+            // On the ring they wait for consumerLock instead, and stop once
+            // they get it.
+            for (int i = 1; i < numConsumers && !lockFree; i++) {
+                sem_post(&full);
+            }
+            break;
         }
     }
 
@@ -233,18 +462,57 @@ void* ConsumerFunction(void* arg) {
 // Parse command line arguments
 void parseArguments(int argc, char* argv[]) {
     numProducers = 1;   // Default value
-    bufferSize = 10;    // Default value
+    numConsumers = 1;   // Default value
+    bufferSize = 10;    // Default value, LOCKFREE_BUFFER_SIZE with -q lockfree
+    bool bufferGiven = false;
+    queueType = SEMAPHORE_QUEUE;
+    batchSize = 1;      // Default value
+    adaptiveBatch = false;
+    flushMillis = 100;  // Default value
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
             numProducers = atoi(argv[i+1]);
             i++;  // Skip the next argument
         } 
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            numConsumers = atoi(argv[i+1]);
+            i++;  // Skip the next argument
+        }
         else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
             bufferSize = atoi(argv[i+1]);
+            bufferGiven = true;
+            i++;  // Skip the next argument
+        }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            adaptiveBatch = strcmp(argv[i+1], "auto") == 0;
+            batchSize = atoi(argv[i+1]);
+            i++;  // Skip the next argument
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            flushMillis = atoi(argv[i+1]);
+            i++;  // Skip the next argument
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            logPolicy.sync = true;
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            if (strcmp(argv[i+1], "sem") == 0) {
+                queueType = SEMAPHORE_QUEUE;
+            }
+            else if (strcmp(argv[i+1], "lockfree") == 0) {
+                queueType = LOCKFREE_QUEUE;
+            }
+            else {
+                cerr << "Error: Invalid queue. Must be sem or lockfree." << endl;
+                exit(1);
+            }
             i++;  // Skip the next argument
         }
     }
+    if (!bufferGiven && queueType == LOCKFREE_QUEUE) {
+        bufferSize = LOCKFREE_BUFFER_SIZE;
+    }
     
     // Validate inputs - treat invalid values as errors
     if (numProducers < 1 || numProducers > MAX_PRODUCERS) {
@@ -252,10 +520,29 @@ void parseArguments(int argc, char* argv[]) {
         exit(1);
     }
     
+    if (numConsumers < 1 || numConsumers > MAX_CONSUMERS) {
+        cerr << "Error: Invalid number of consumers. Must be between 1 and " << MAX_CONSUMERS << "." << endl;
+        exit(1);
+    }
+    
     if (bufferSize < 1 || bufferSize > MAX_BUFFER_SIZE) {
         cerr << "Error: Invalid buffer size. Must be between 1 and " << MAX_BUFFER_SIZE << "." << endl;
         exit(1);
     }
+    
+    // A batch has to fit in the buffer. -k auto leaves room for others.
+    if (adaptiveBatch) {
+        batchSize = max(1, min(ADAPTIVE_BATCH_LIMIT, bufferSize / 4));
+    }
+    else if (batchSize < 1 || batchSize > bufferSize) {
+        cerr << "Error: Invalid batch size. Must be auto or between 1 and the buffer size." << endl;
+        exit(1);
+    }
+    
+    if (flushMillis < 0 || flushMillis > MAX_FLUSH_MILLIS) {
+        cerr << "Error: Invalid flush interval. Must be between 0 and " << MAX_FLUSH_MILLIS << " ms." << endl;
+        exit(1);
+    }
 }
 
 
@@ -266,8 +553,22 @@ int main(int argc, char* argv[]) {
     // Load the inventory
     LoadInventory();
     
+    // Open the log, and start flushing it on time. Without a log the orders
+    // are still processed, as when the log could not be opened per order.
+    pthread_t flusherThread;
+    bool flushing = false;
+    if (transactionLog.open("log", logPolicy) && flushMillis > 0) {
+        flushing = pthread_create(&flusherThread, NULL, FlusherFunction, NULL) == 0;
+    }
+    
     // Initialize buffer for the producer-consumer problem
-    buffer = new Order[bufferSize];
+    if (queueType == LOCKFREE_QUEUE) {
+        buffer = NULL;
+        ring = new BoundedRing<Order>(bufferSize);  // Rounded up to a power of two
+    }
+    else {
+        buffer = new Order[bufferSize];
+    }
     
     // Initialize semaphores for synchronization
     sem_init(&emptySlots, 0, bufferSize);  // Buffer starts empty (all slots are empty)
@@ -276,7 +577,7 @@ int main(int argc, char* argv[]) {
     
     // Create producer and consumer threads
     pthread_t producerThreads[MAX_PRODUCERS];
-    pthread_t consumerThread;
+    pthread_t consumerThreads[MAX_CONSUMERS];
     int producerIDs[MAX_PRODUCERS];
     
     // Initialize and create producer threads
@@ -295,10 +596,12 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    // Create consumer thread
-    if (pthread_create(&consumerThread, NULL, ConsumerFunction, NULL) != 0) {
-        cerr << "Error: Failed to create consumer thread." << endl;
-        exit(1);
+    // Create consumer threads
+    for (int i = 0; i < numConsumers; i++) {
+        if (pthread_create(&consumerThreads[i], NULL, ConsumerFunction, NULL) != 0) {
+            cerr << "Error: Failed to create consumer thread." << endl;
+            exit(1);
+        }
     }
     
     // Check thread return values
@@ -310,17 +613,30 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    pthread_join(consumerThread, &status);
-    if (status != NULL) {
-        errorMessage = "Error: Consumer thread encountered an error.";
-        hasError = true;
+    for (int i = 0; i < numConsumers; i++) {
+        pthread_join(consumerThreads[i], &status);
+        if (status != NULL) {
+            errorMessage = "Error: Consumer thread encountered an error.";
+            hasError = true;
+        }
+    }
+    
+    // Every line is logged: stop the flusher and write out the rest
+    if (flushing) {
+        pthread_mutex_lock(&logMutex);
+        consumersDone = true;
+        pthread_cond_signal(&flusherWake);
+        pthread_mutex_unlock(&logMutex);
+        pthread_join(flusherThread, NULL);
     }
+    transactionLog.close();
     
     // Cleanup
     sem_destroy(&emptySlots);
     sem_destroy(&full);
     sem_destroy(&mutex);
     delete[] buffer;
+    delete ring;
     
     // Save updated inventory
     SaveInventory();
@@ -0,0 +1,119 @@
+import argparse
+import csv
+import os
+import random
+import shutil
+import subprocess
+import sys
+import time
+
+DEFAULT_CONSUMERS = "1,2,4,8,16"
+
+CSV_FIELDS = ["queue", "batch", "producers", "consumers", "buffer", "orders", "status", "wall_s", "orders_per_s", "speedup",
+              "matches_serial"]
+
+DESCRIPTIONS = ["Wireless Mouse", "USB Cable", "Mechanical Keyboard", "Monitor Stand", "Desk Lamp", "Webcam"]
+
+
+def create_workload(directory, products, orders, producers, seed):
+    """Write inventory.old and orders1..ordersN. About 5% of the orders name
+    a product that does not exist, and stock runs out for the popular ones,
+    so every kind of log line shows up."""
+    rng = random.Random(seed)
+    with open(os.path.join(directory, "inventory.old"), "w") as f:
+        for i in range(products):
+            f.write(f"{1000 + i} {rng.randint(100, 99999) / 100:.2f} {rng.randint(0, 500)} "
+                    f"{rng.choice(DESCRIPTIONS)} {i}\n")
+    for producer in range(1, producers + 1):
+        with open(os.path.join(directory, f"orders{producer}"), "w") as f:
+            for _ in range(orders):
+                product = 1000 + rng.randint(0, products + products // 20)
+                f.write(f"{rng.randint(1, 9999999)} {product} {rng.randint(1, 6)}\n")
+
+
+def run_orders(program, directory, queue, batch, producers, consumers, buffer_size):
+    """Run proj05 once from a fresh log and return the wall time and outputs."""
+    log = os.path.join(directory, "log")
+    if os.path.exists(log):
+        os.remove(log)
+    cmd = [os.path.abspath(program), "-q", queue, "-k", batch, "-p", str(producers), "-c", str(consumers), "-b", str(buffer_size)]
+    start = time.perf_counter()
+    result = subprocess.run(cmd, cwd=directory, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    wall = time.perf_counter() - start
+    outputs = None
+    if result.returncode == 0:
+        with open(log, "rb") as f:
+            log_data = f.read()
+        with open(os.path.join(directory, "inventory.new"), "rb") as f:
+            outputs = (log_data, f.read())
+    else:
+        print(f"  -c {consumers} failed: {result.stderr.strip()}", file=sys.stderr)
+    return wall, outputs
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure how proj05 scales with the number of consumers (-c) "
+                                                 "on each buffer (-q) and batch size (-k).")
+    parser.add_argument("--program", default="./proj05", help="proj05 binary (default ./proj05)")
+    parser.add_argument("--dir", default="bench_data", help="scratch directory for the workload")
+    parser.add_argument("--csv", default="bench.csv", help="CSV file to write (default bench.csv)")
+    parser.add_argument("--consumers", default=DEFAULT_CONSUMERS, help=f"-c values (default {DEFAULT_CONSUMERS})")
+    parser.add_argument("--producers", default="1,9", help="-p values (default 1,9)")
+    parser.add_argument("--queues", default="sem,lockfree", help="-q values (default sem,lockfree)")
+    parser.add_argument("--batches", default="1,auto", help="-k values (default 1,auto)")
+    parser.add_argument("--buffer", type=int, default=4096, help="-b for every run (default 4096)")
+    parser.add_argument("--orders", type=int, default=100000, help="orders per producer (default 100000)")
+    parser.add_argument("--products", type=int, default=10000, help="products in the inventory (default 10000)")
+    parser.add_argument("--seed", type=int, default=1, help="workload seed (default 1)")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per combination, the fastest counts (default 3)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.program):
+        print(f"Error: '{args.program}' not found, run make first.")
+        sys.exit(1)
+    consumers = [int(c) for c in args.consumers.split(",")]
+    producer_counts = [int(p) for p in args.producers.split(",")]
+
+    os.makedirs(args.dir, exist_ok=True)
+    print(f"Creating {max(producer_counts)} x {args.orders} orders over {args.products} products...")
+    create_workload(args.dir, args.products, args.orders, max(producer_counts), args.seed)
+    rows = 0
+    with open(args.csv, "w", newline="") as out:
+        writer = csv.DictWriter(out, fieldnames=CSV_FIELDS)
+        writer.writeheader()
+        for producers in producer_counts:
+            # The first single-consumer run is the baseline for every queue and batch size
+            serial_wall = None
+            serial_outputs = None
+            combinations = [(queue, batch, count) for queue in args.queues.split(",")
+                            for batch in args.batches.split(",") for count in consumers]
+            for queue, batch, count in combinations:
+                best = None
+                outputs = None
+                for _ in range(args.repeat):
+                    wall, outputs = run_orders(args.program, args.dir, queue, batch, producers, count, args.buffer)
+                    if outputs is None:
+                        break
+                    best = wall if best is None else min(best, wall)
+                row = {"queue": queue, "batch": batch, "producers": producers, "consumers": count,
+                       "buffer": args.buffer, "orders": producers * args.orders, "status": "ok" if outputs else "failed"}
+                if outputs:
+                    if count == 1 and serial_wall is None:
+                        serial_wall, serial_outputs = best, outputs
+                    row.update({"wall_s": round(best, 4), "orders_per_s": int(row["orders"] / best)})
+                    if serial_wall:
+                        row["speedup"] = round(serial_wall / best, 2)
+                    # Arrival order, and so the log, only repeats from run to run with one producer
+                    if producers == 1 and serial_outputs:
+                        row["matches_serial"] = "yes" if outputs == serial_outputs else "NO"
+                writer.writerow(row)
+                out.flush()
+                rows += 1
+                print(f"  -q {queue:<8} -k {batch:<4} -p {producers} -c {count:<3} "
+                      f"{row.get('orders_per_s', '-'):>9} orders/s  x{row.get('speedup', '-'):<5}  {row['status']}")
+    shutil.rmtree(args.dir)
+    print(f"\n{rows} runs written to {args.csv}")
+
+
+if __name__ == "__main__":
+    main()
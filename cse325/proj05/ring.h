@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+
+// Bounded lock-free multi-producer, single-consumer queue, after Dmitry
+// Vyukov's bounded queue. Every slot carries a sequence number that says
+// whose turn it is: the producer that claimed position pos may fill the slot
+// when its sequence is pos, and the consumer may empty it when it is pos + 1.
+// Producers claim positions with one compare-and-swap on the tail, so an
+// uncontended push or pop is a few atomic operations and no system call.
+// Items move in batches: a push claims a run of positions with that one
+// compare-and-swap, and a pop takes every published item up to its limit.
+//
+// A producer that finds the queue full, or the consumer that finds it empty,
+// spins for a while and then parks on a condition variable. That is the only
+// time a lock is taken, and the other side only takes it to wake a thread
+// that is actually parked.
+//
+// Only one thread may pop at a time. Several consumers must take turns
+// themselves, with a lock around pop().
+template <typename T>
+class BoundedRing {
+public:
+    // Capacity is rounded up to a power of two, and at least 2.
+    explicit BoundedRing(size_t capacity);
+    ~BoundedRing();
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+    // Adds count items, at most capacity(), in order and next to each other,
+    // waiting until there is room for all of them. Returns roughly how many
+    // items were waiting ahead of them.
+    size_t push(const T* items, size_t count);
+    // Removes the oldest items, waiting while the queue is empty. Takes
+    // every published item up to limit and returns how many.
+    size_t pop(T* items, size_t limit);
+
+private:
+    // Checks before parking. On one CPU, spinning only delays the thread
+    // that would make progress, so this is kept short.
+    static const int SPIN_LIMIT = 128;
+
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    // Where threads wait when spinning did not help
+    struct Parking {
+        pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+        std::atomic<int> waiters{0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail{0};    // Next position a producer claims
+    alignas(64) std::atomic<size_t> head{0};    // Next position the consumer empties. Producers
+                                                // read it to estimate the backlog.
+    Parking notFull;                            // Producers wait here
+    Parking notEmpty;                           // The consumer waits here
+
+    // True once sequence, the slot's sequence number, has reached target
+    static bool reached(size_t sequence, size_t target) { return (intptr_t)(sequence - target) >= 0; }
+    static void relax();
+    template <typename Ready> static void park(Parking& parking, Ready ready);
+    static void wake(Parking& parking);
+};
+
+template <typename T>
+BoundedRing<T>::BoundedRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+BoundedRing<T>::~BoundedRing() {
+    for (Parking* parking : {&notFull, &notEmpty}) {
+        pthread_mutex_destroy(&parking->lock);
+        pthread_cond_destroy(&parking->wake);
+    }
+}
+
+template <typename T>
+void BoundedRing<T>::relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Sleep until ready() is true. The waiter count goes up before the last
+// check of ready(), and wake() reads it after the change that makes ready()
+// true, with a full fence on each side: either this thread sees the change,
+// or wake() sees the waiter and signals it.
+template <typename T>
+template <typename Ready>
+void BoundedRing<T>::park(Parking& parking, Ready ready) {
+    parking.waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    pthread_mutex_lock(&parking.lock);
+    while (!ready())
+        pthread_cond_wait(&parking.wake, &parking.lock);
+    pthread_mutex_unlock(&parking.lock);
+    parking.waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+void BoundedRing<T>::wake(Parking& parking) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parking.waiters.load(std::memory_order_relaxed) == 0)
+        return;
+    pthread_mutex_lock(&parking.lock);
+    pthread_cond_broadcast(&parking.wake);
+    pthread_mutex_unlock(&parking.lock);
+}
+
+template <typename T>
+size_t BoundedRing<T>::push(const T* items, size_t count) {
+    size_t position = tail.load(std::memory_order_relaxed);
+    size_t consumed;
+    int spins = 0;
+    while (true) {
+        // The consumer frees slots in order, so if the last slot of the run
+        // is free for its position, so are the ones before it
+        size_t last = position + count - 1;
+        Slot& slot = slots[last & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == last) {
+            // The backlog is measured before the claim: the consumer cannot
+            // be past the tail yet, while once the run is published it may
+            // already have taken it
+            consumed = head.load(std::memory_order_relaxed);
+            // Claim the whole run
+            if (tail.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) {
+                break;
+            }
+            // Another producer claimed it first, position now holds the new tail
+        }
+        else if (!reached(sequence, last)) {
+            // Still holds an item from one lap ago: not enough room
+            if (++spins < SPIN_LIMIT) {
+                relax();
+            } else {
+                park(notFull, [&] { return reached(slot.sequence.load(std::memory_order_acquire), last); });
+                spins = 0;
+            }
+            position = tail.load(std::memory_order_relaxed);
+        }
+        else {
+            // Other producers filled these positions already
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Slot& slot = slots[(position + i) & mask];
+        slot.item = items[i];
+        slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    wake(notEmpty);
+    return position - consumed;
+}
+
+template <typename T>
+size_t BoundedRing<T>::pop(T* items, size_t limit) {
+    size_t position = head.load(std::memory_order_relaxed);
+    Slot* slot = &slots[position & mask];
+    int spins = 0;
+    while (!reached(slot->sequence.load(std::memory_order_acquire), position + 1)) {
+        if (++spins < SPIN_LIMIT) {
+            relax();
+        } else {
+            park(notEmpty, [&] { return reached(slot->sequence.load(std::memory_order_acquire), position + 1); });
+            spins = 0;
+        }
+    }
+
+    size_t count = 0;
+    do {
+        items[count++] = slot->item;
+        // Free for the position one lap ahead
+        slot->sequence.store(position + mask + 1, std::memory_order_release);
+        position++;
+        slot = &slots[position & mask];
+    } while (count < limit && slot->sequence.load(std::memory_order_acquire) == position + 1);
+    head.store(position, std::memory_order_relaxed);
+    wake(notFull);
+    return count;
+}
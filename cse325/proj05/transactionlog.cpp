@@ -0,0 +1,130 @@
+#include "transactionlog.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Longest line apart from the description and money fields: two 10-digit
+// IDs, a 10-digit quantity, the separators, "$", "rejected" and the newline
+static const size_t LINE_OVERHEAD = 46;
+static const size_t DESCRIPTION_WIDTH = 30;
+static const size_t MONEY_WIDTH = 9;
+static const size_t MONEY_SIZE = 400;       // "%.2f" of the largest double fits
+
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Writes value right-aligned in width characters, padded with fill, or in
+// full if it is wider, like setw and setfill. Returns the new end.
+static char* putNumber(char* out, unsigned int value, int width, char fill) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (int i = count; i < width; i++)
+        *out++ = fill;
+    while (count > 0)
+        *out++ = digits[--count];
+    return out;
+}
+
+// Writes text left-aligned in width characters, padded with spaces
+static char* putText(char* out, const char* text, size_t length, size_t width) {
+    memcpy(out, text, length);
+    out += length;
+    for (size_t i = length; i < width; i++)
+        *out++ = ' ';
+    return out;
+}
+
+bool TransactionLog::open(const char* path, const LogPolicy& logPolicy) {
+    close();
+    policy = logPolicy;
+    fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        cerr << "Error: Could not create log file." << endl;
+        return false;
+    }
+    buffer.resize(policy.flushBytes + LINE_OVERHEAD + DESCRIPTION_WIDTH + MONEY_SIZE);
+    used = 0;
+    failed = false;
+    return true;
+}
+
+void TransactionLog::close() {
+    if (fd == -1)
+        return;
+    flush();
+    ::close(fd);
+    fd = -1;
+}
+
+void TransactionLog::append(unsigned int customerID, unsigned int productID, const string& description,
+                            unsigned int quantity, double amount, bool result) {
+    if (fd == -1)
+        return;
+    // The amount goes through printf, which rounds exactly as the stream did
+    char money[MONEY_SIZE];
+    int moneyLength = snprintf(money, sizeof(money), "%.2f", amount);
+
+    // Both fields are padded, so a short one still takes its full width
+    size_t longest = LINE_OVERHEAD + max(description.size(), DESCRIPTION_WIDTH)
+                     + max((size_t)moneyLength, MONEY_WIDTH);
+    if (used + longest > buffer.size()) {
+        flush();
+        if (longest > buffer.size())
+            buffer.resize(longest);
+    }
+
+    char* out = buffer.data() + used;
+    out = putNumber(out, customerID, 7, '0');
+    *out++ = ' ';
+    out = putNumber(out, productID, 6, '0');
+    *out++ = ' ';
+    out = putText(out, description.data(), description.size(), DESCRIPTION_WIDTH);
+    *out++ = ' ';
+    out = putNumber(out, quantity, 5, ' ');
+    *out++ = ' ';
+    *out++ = ' ';
+    *out++ = '$';
+    out = putText(out, money, moneyLength, MONEY_WIDTH);
+    *out++ = ' ';
+    out = result ? putText(out, "filled", 6, 0) : putText(out, "rejected", 8, 0);
+    *out++ = '\n';
+    used = out - buffer.data();
+
+    if (used >= policy.flushBytes)
+        flush();
+}
+
+void TransactionLog::flush() {
+    if (fd == -1 || used == 0)
+        return;
+    bool written = writeAll(fd, buffer.data(), used);
+    if (written && policy.sync)
+        written = fdatasync(fd) == 0;
+    if (!written && !failed) {
+        cerr << "Error: Could not write log file." << endl;
+        failed = true;
+    }
+    used = 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// When buffered log lines reach the file
+struct LogPolicy {
+    size_t flushBytes = 1 << 16;    // Write once this much is buffered
+    bool sync = false;              // fdatasync after each write, so one sync commits a whole group of lines
+};
+
+// The transaction log, kept open for the whole run. append() formats a line
+// by hand into a large buffer, with no iostream and no system call, and the
+// buffer goes to the file in one write when it fills or flush() is called.
+// The lines are byte for byte what the per-order ofstream wrote.
+//
+// Not thread-safe: callers serialize append() and flush() themselves.
+class TransactionLog {
+public:
+    TransactionLog() {}
+    ~TransactionLog() { close(); }
+    TransactionLog(const TransactionLog&) = delete;
+    TransactionLog& operator=(const TransactionLog&) = delete;
+
+    // Opens path for appending. Returns false, with a message on stderr, if
+    // it cannot be opened; append() then does nothing.
+    bool open(const char* path, const LogPolicy& policy);
+    // Writes out what is buffered and closes the file.
+    void close();
+
+    // <customerID> <productID> <description> <quantity>  $<amount> filled|rejected
+    void append(unsigned int customerID, unsigned int productID, const std::string& description,
+                unsigned int quantity, double amount, bool result);
+    // Writes the buffered lines, and syncs them under LogPolicy::sync.
+    void flush();
+    bool empty() const { return used == 0; }
+
+private:
+    int fd = -1;
+    LogPolicy policy;
+    std::vector<char> buffer;
+    size_t used = 0;
+    bool failed = false;            // A write failed and was reported
+};